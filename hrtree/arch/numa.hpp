@@ -0,0 +1,197 @@
+// hrtree/arch/numa.hpp header file
+//
+// Part of the Hilbert Rtree library.
+// Copyright (c) 2000-2014 Hanno Hildenbrandt
+//
+// This software is provided "as is" without express or implied warranty,
+// and with no claim as to its suitability for any purpose.
+//
+// Minimal NUMA support without libnuma: node topology, thread pinning
+// and parallel first touch. Pages are placed on the node of the thread
+// that touches them first (Linux and Windows default policy).
+
+
+#ifndef HRTREE_ARCH_NUMA_HPP_INCLUDED
+#define HRTREE_ARCH_NUMA_HPP_INCLUDED
+
+#include <vector>
+#include <fstream>
+#include <string>
+#include <hrtree/config.hpp>
+#include <hrtree/arch/parallel.hpp>
+#ifdef _WIN32
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+#else
+  #include <sched.h>
+  #include <unistd.h>
+  #include <pthread.h>
+#endif
+
+
+namespace hrtree { namespace arch {
+
+
+  enum pin_policy
+  {
+    pin_none,       // leave placement to the OS
+    pin_compact,    // thread i -> cpu i, fills one node after the other
+    pin_scatter     // thread i -> node i % nodes, round robin over nodes
+  };
+
+
+  namespace detail {
+
+    // cpu -> node map, empty if unknown
+    inline const std::vector<int>& numa_cpu_nodes()
+    {
+      static const std::vector<int> map = []() {
+        std::vector<int> m;
+#ifdef _WIN32
+        const int ncpu = (int)GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+        for (int cpu = 0; cpu < ncpu; ++cpu)
+        {
+          PROCESSOR_NUMBER pn = { WORD(cpu / 64), BYTE(cpu % 64), 0 };
+          USHORT node = 0;
+          m.push_back(GetNumaProcessorNodeEx(&pn, &node) ? int(node) : 0);
+        }
+#else
+        const int ncpu = (int)sysconf(_SC_NPROCESSORS_CONF);
+        m.assign(ncpu > 0 ? ncpu : 0, 0);
+        for (int node = 0; ; ++node)
+        {
+          std::ifstream is("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+          if (!is) break;
+          std::string list;
+          std::getline(is, list);
+          // "0-7,16-23"
+          for (size_t pos = 0; pos < list.size(); )
+          {
+            size_t end = list.find(',', pos);
+            if (end == std::string::npos) end = list.size();
+            const std::string range = list.substr(pos, end - pos);
+            const size_t dash = range.find('-');
+            const int lo = std::stoi(range);
+            const int hi = (dash == std::string::npos) ? lo : std::stoi(range.substr(dash + 1));
+            for (int cpu = lo; cpu <= hi && cpu < (int)m.size(); ++cpu) m[cpu] = node;
+            pos = end + 1;
+          }
+        }
+#endif
+        return m;
+      }();
+      return map;
+    }
+
+  }
+
+
+  inline int num_cpus()
+  {
+    return std::max<int>(1, (int)detail::numa_cpu_nodes().size());
+  }
+
+
+  inline int numa_num_nodes()
+  {
+    const std::vector<int>& m = detail::numa_cpu_nodes();
+    return m.empty() ? 1 : 1 + *std::max_element(m.begin(), m.end());
+  }
+
+
+  inline int numa_node_of_cpu(int cpu)
+  {
+    const std::vector<int>& m = detail::numa_cpu_nodes();
+    return (cpu >= 0 && cpu < (int)m.size()) ? m[cpu] : 0;
+  }
+
+
+  // Node of the cpu the calling thread currently runs on.
+  inline int numa_current_node()
+  {
+#ifdef _WIN32
+    PROCESSOR_NUMBER pn;
+    GetCurrentProcessorNumberEx(&pn);
+    return numa_node_of_cpu(pn.Group * 64 + pn.Number);
+#else
+    return numa_node_of_cpu(sched_getcpu());
+#endif
+  }
+
+
+  // Pins the calling thread to the given cpu.
+  inline bool pin_thread(int cpu)
+  {
+#ifdef _WIN32
+    GROUP_AFFINITY ga = {};
+    ga.Group = WORD(cpu / 64);
+    ga.Mask = KAFFINITY(1) << (cpu % 64);
+    return 0 != SetThreadGroupAffinity(GetCurrentThread(), &ga, 0);
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return 0 == pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+  }
+
+
+  // The cpu the thread with the given number is pinned to.
+  inline int pin_cpu(pin_policy policy, int thread)
+  {
+    const int ncpu = num_cpus();
+    if (pin_scatter == policy)
+    {
+      const int nodes = numa_num_nodes();
+      std::vector<int> cpus;
+      for (int cpu = 0; cpu < ncpu; ++cpu)
+      {
+        if (numa_node_of_cpu(cpu) == thread % nodes) cpus.push_back(cpu);
+      }
+      if (!cpus.empty()) return cpus[(thread / nodes) % cpus.size()];
+    }
+    return thread % ncpu;
+  }
+
+
+  // Pins the threads of subsequent parallel regions.
+  // Relies on the backend to reuse its threads.
+  inline void pin_threads(pin_policy policy)
+  {
+    if (pin_none == policy) return;
+    parallel_region([policy](team& t)
+    {
+      pin_thread(pin_cpu(policy, t.thread_num()));
+    });
+  }
+
+
+  // Touches the pages of the freshly allocated block [ptr, ptr + bytes)
+  // with a static schedule: thread i touches the i-th contiguous block
+  // and thus places it on its node. Later access with the same static
+  // schedule is node local, any other access sees the block spread over
+  // the nodes. page shall be the page size backing the block, e.g.
+  // HRTREE_HUGE_PAGE_SIZE. Serial inside a parallel region: the memory
+  // goes to the node of the calling thread.
+  inline void parallel_first_touch(void* ptr, size_t bytes, size_t page = 4096)
+  {
+    char* p = (char*)ptr;
+    const std::ptrdiff_t pages = std::ptrdiff_t((bytes + page - 1) / page);
+    parallel_for(std::ptrdiff_t(0), pages, [=](std::ptrdiff_t i)
+    {
+      p[size_t(i) * page] = 0;
+    }, hrtree_max_num_threads(), !in_parallel());
+  }
+
+}
+
+using arch::pin_policy;
+using arch::pin_threads;
+using arch::numa_num_nodes;
+using arch::numa_current_node;
+
+}
+
+#endif
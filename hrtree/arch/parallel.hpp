@@ -0,0 +1,260 @@
+// hrtree/arch/parallel.hpp header file
+//
+// Part of the Hilbert Rtree library.
+// Copyright (c) 2000-2014 Hanno Hildenbrandt
+//
+// This software is provided "as is" without express or implied warranty,
+// and with no claim as to its suitability for any purpose.
+//
+// Execution backend of the parallel algorithms, selected by
+// HRTREE_PARALLEL_BACKEND in config.hpp: OpenMP, a persistent
+// std::thread pool or serial.
+
+
+#ifndef HRTREE_ARCH_PARALLEL_HPP_INCLUDED
+#define HRTREE_ARCH_PARALLEL_HPP_INCLUDED
+
+#include <vector>
+#include <mutex>
+#include <exception>
+#include <algorithm>
+#include <hrtree/config.hpp>
+#include <hrtree/arch/thread_pool.hpp>
+
+
+namespace hrtree { namespace arch {
+
+
+  // Thread team of a parallel region.
+  class team
+  {
+  public:
+    team(int tid, int nt, void* impl = nullptr) : tid_(tid), nt_(nt), impl_(impl) {}
+
+    int thread_num() const { return tid_; }
+    int num_threads() const { return nt_; }
+
+    // All threads of the team shall call barrier the same number of times.
+    void barrier()
+    {
+      if (nt_ > 1)
+      {
+#if HRTREE_PARALLEL_BACKEND == HRTREE_BACKEND_OPENMP
+#       pragma omp barrier
+#elif HRTREE_PARALLEL_BACKEND == HRTREE_BACKEND_THREADS
+        static_cast<thread_pool*>(impl_)->barrier();
+#endif
+      }
+    }
+
+    // [first, last) of the static block of the calling thread
+    template <typename I>
+    std::pair<I, I> static_block(I first, I last) const
+    {
+      const I n = last - first;
+      const I chunk = (n + nt_ - 1) / nt_;
+      const I i0 = std::min<I>(n, chunk * tid_);
+      const I i1 = std::min<I>(n, i0 + chunk);
+      return std::make_pair(first + i0, first + i1);
+    }
+
+  private:
+    int tid_;
+    int nt_;
+    void* impl_;
+  };
+
+
+  // True inside an active parallel region.
+  inline bool in_parallel()
+  {
+#if HRTREE_PARALLEL_BACKEND == HRTREE_BACKEND_OPENMP
+    return 0 != omp_in_parallel();
+#elif HRTREE_PARALLEL_BACKEND == HRTREE_BACKEND_THREADS
+    return thread_pool::in_region();
+#else
+    return false;
+#endif
+  }
+
+
+  // Runs fun(team&) on up to numt threads, on the calling thread alone
+  // if !cond or if nested. The first exception thrown by fun is rethrown,
+  // fun shall not throw between barriers.
+  template <typename Fun>
+  inline void parallel_region(int numt, bool cond, Fun fun)
+  {
+    std::mutex emutex;
+    std::exception_ptr eptr;
+    numt = cond ? std::max(1, numt) : 1;
+#if HRTREE_PARALLEL_BACKEND == HRTREE_BACKEND_OPENMP
+#   pragma omp parallel if(numt > 1) num_threads(numt)
+    {
+      team t(omp_get_thread_num(), omp_get_num_threads());
+      try
+      {
+        fun(t);
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lock(emutex);
+        if (!eptr) eptr = std::current_exception();
+      }
+    }
+#elif HRTREE_PARALLEL_BACKEND == HRTREE_BACKEND_THREADS
+    thread_pool& pool = thread_pool::instance();
+    auto body = [&](int tid, int nt) {
+      team t(tid, nt, &pool);
+      fun(t);
+    };
+    try
+    {
+      pool.run(numt, body);
+    }
+    catch (...)
+    {
+      eptr = std::current_exception();
+    }
+#else
+    try
+    {
+      team t(0, 1);
+      fun(t);
+    }
+    catch (...)
+    {
+      eptr = std::current_exception();
+    }
+#endif
+    if (eptr) std::rethrow_exception(eptr);
+  }
+
+
+  template <typename Fun>
+  inline void parallel_region(Fun fun)
+  {
+    parallel_region(hrtree_max_num_threads(), true, fun);
+  }
+
+
+  // fun(i) for i in [first, last), one contiguous block per thread
+  // (schedule(static)).
+  template <typename I, typename Fun>
+  inline void parallel_for(I first, I last, Fun fun, int numt = hrtree_max_num_threads(), bool cond = true)
+  {
+    parallel_region(numt, cond && (last - first) > 1, [&](team& t) {
+      const auto block = t.static_block(first, last);
+      for (I i = block.first; i < block.second; ++i)
+      {
+        fun(i);
+      }
+    });
+  }
+
+
+namespace detail {
+
+  template <typename I>
+  struct HRTREE_ALIGN_CACHELINE steal_range
+  {
+    std::mutex mutex;
+    I begin;
+    I end;
+  };
+
+}
+
+
+  // fun(i) for i in [first, last) with work stealing: each thread starts
+  // on its static block and takes grain sized pieces from the front. Idle
+  // threads steal the back half of the remaining work of another thread.
+  template <typename I, typename Fun>
+  inline void parallel_for_dynamic(I first, I last, I grain, Fun fun, int numt = hrtree_max_num_threads())
+  {
+    grain = std::max<I>(grain, 1);
+    numt = int(std::min<I>(I(numt), (last - first + grain - 1) / grain));
+    std::vector<detail::steal_range<I>> ranges(std::max(numt, 1));
+    parallel_region(numt, numt > 1, [&](team& t) {
+      const int nt = t.num_threads();
+      const int tid = t.thread_num();
+      detail::steal_range<I>& own = ranges[tid];
+      {
+        const auto block = t.static_block(first, last);
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.begin = block.first;
+        own.end = block.second;
+      }
+      t.barrier();
+      for (;;)
+      {
+        I i0, i1;
+        {
+          std::lock_guard<std::mutex> lock(own.mutex);
+          i0 = own.begin;
+          i1 = std::min<I>(own.end, i0 + grain);
+          own.begin = i1;
+        }
+        if (i0 < i1)
+        {
+          for (I i = i0; i < i1; ++i) fun(i);
+          continue;
+        }
+        bool stolen = false;
+        for (int k = 1; k < nt && !stolen; ++k)
+        {
+          detail::steal_range<I>& victim = ranges[(tid + k) % nt];
+          std::lock_guard<std::mutex> lock(victim.mutex);
+          const I rest = victim.end - victim.begin;
+          if (rest > 0)
+          {
+            i1 = victim.end;
+            i0 = victim.end - (rest + 1) / 2;
+            victim.end = i0;
+            stolen = true;
+          }
+        }
+        if (!stolen) break;
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.begin = i0;
+        own.end = i1;
+      }
+    });
+  }
+
+
+  // op(init, fun(i)...) over [first, last), partial results of the static
+  // blocks are combined in block order.
+  template <typename I, typename T, typename Fun, typename Op>
+  inline T parallel_reduce(I first, I last, T init, Fun fun, Op op, int numt = hrtree_max_num_threads())
+  {
+    std::vector<T> partial(std::max(numt, 1), init);
+    std::vector<char> used(partial.size(), 0);
+    parallel_region(numt, (last - first) > 1, [&](team& t) {
+      const auto block = t.static_block(first, last);
+      if (block.first < block.second)
+      {
+        T x = fun(block.first);
+        for (I i = block.first + 1; i < block.second; ++i) x = op(x, fun(i));
+        partial[t.thread_num()] = x;
+        used[t.thread_num()] = 1;
+      }
+    });
+    T res = init;
+    for (size_t t = 0; t < partial.size(); ++t)
+    {
+      if (used[t]) res = op(res, partial[t]);
+    }
+    return res;
+  }
+
+
+}
+
+using arch::parallel_region;
+using arch::parallel_for;
+using arch::parallel_for_dynamic;
+using arch::parallel_reduce;
+
+}
+
+#endif
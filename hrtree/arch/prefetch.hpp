@@ -0,0 +1,57 @@
+// hrtree/arch/prefetch.hpp header file
+//
+// Part of the Hilbert Rtree library.
+// Copyright (c) 2000-2014 Hanno Hildenbrandt
+//
+// This software is provided "as is" without express or implied warranty,
+// and with no claim as to its suitability for any purpose.
+
+#ifndef HRTREE_ARCH_PREFETCH_HPP_INCLUDED
+#define HRTREE_ARCH_PREFETCH_HPP_INCLUDED
+
+#include <hrtree/config.hpp>
+#include <hrtree/arch/select.hpp>
+
+
+namespace hrtree {
+
+
+  // Prefetches LINES cache lines starting at p into all cache levels.
+  template <int LINES>
+  inline void prefetch(const void* p)
+  {
+    for (int i = 0; i < LINES; ++i)
+    {
+#if (defined(HRTREE_HAS_AVX) || defined(HRTREE_HAS_SSE2))
+      _mm_prefetch(static_cast<const char*>(p) + i * HRTREE_CACHELINE_SIZE, _MM_HINT_T0);
+#elif defined(__GNUC__)
+      __builtin_prefetch(static_cast<const char*>(p) + i * HRTREE_CACHELINE_SIZE, 0, 3);
+#endif
+    }
+  }
+
+
+  template <>
+  inline void prefetch<0>(const void*)
+  {
+  }
+
+
+  // Prefetches lines cache lines starting at p into all cache levels.
+  inline void prefetch(const void* p, size_t lines)
+  {
+    for (size_t i = 0; i < lines; ++i)
+    {
+#if (defined(HRTREE_HAS_AVX) || defined(HRTREE_HAS_SSE2))
+      _mm_prefetch(static_cast<const char*>(p) + i * HRTREE_CACHELINE_SIZE, _MM_HINT_T0);
+#elif defined(__GNUC__)
+      __builtin_prefetch(static_cast<const char*>(p) + i * HRTREE_CACHELINE_SIZE, 0, 3);
+#endif
+    }
+  }
+
+
+}
+
+
+#endif
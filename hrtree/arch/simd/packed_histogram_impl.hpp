@@ -0,0 +1,54 @@
+// hrtree/arch/simd/packed_histogram_impl.hpp header file
+//
+// Part of the Hilbert Rtree library.
+// Copyright (c) 2000-2014 Hanno Hildenbrandt
+//
+// This software is provided "as is" without express or implied warranty,
+// and with no claim as to its suitability for any purpose.
+
+
+#ifndef HRTREE_ARCH_SIMD_PACKED_HISTOGRAM_IMPL_HPP_INCLUDED
+#define HRTREE_ARCH_SIMD_PACKED_HISTOGRAM_IMPL_HPP_INCLUDED
+
+#include <immintrin.h>
+#include <hrtree/sorting/packed_radix_sort.hpp>
+
+
+namespace hrtree { namespace sorting { namespace detail {
+
+
+  // AVX2 histogram of all passes. The digits of four records are
+  // extracted at once; the bin increments remain scalar.
+  // The counts of even and odd records go to separate tables to break
+  // the store-to-load dependency on runs of equal digits.
+  template <typename I>
+  inline void packed_histogram(const packed_keyidx_t* src, I N, const radix_digits& rd, int key_shift, I* hist)
+  {
+    const int stride = rd.passes * rd.bins;
+    std::vector<I> odd(stride, 0);
+    const __m256i key_mask = _mm256_set1_epi64x((long long)rd.key_mask);
+    const __m256i mask = _mm256_set1_epi64x((long long)rd.mask);
+    const __m128i kshift = _mm_cvtsi32_si128(key_shift);
+    HRTREE_ALIGN(32) std::uint64_t d[4];
+    I i = 0;
+    for (; i + 4 <= N; i += 4)
+    {
+      const __m256i key = _mm256_and_si256(_mm256_srl_epi64(_mm256_loadu_si256((const __m256i*)(src + i)), kshift), key_mask);
+      for (int pass = 0; pass < rd.passes; ++pass)
+      {
+        const __m128i shift = _mm_cvtsi32_si128(pass * rd.bits);
+        _mm256_store_si256((__m256i*)d, _mm256_and_si256(_mm256_srl_epi64(key, shift), mask));
+        I* const h0 = hist + pass * rd.bins;
+        I* const h1 = odd.data() + pass * rd.bins;
+        ++h0[d[0]]; ++h1[d[1]];
+        ++h0[d[2]]; ++h1[d[3]];
+      }
+    }
+    for (int b = 0; b < stride; ++b) hist[b] += odd[b];
+    packed_histogram_scalar(src + i, N - i, rd, key_shift, hist);
+  }
+
+}}}
+
+
+#endif
@@ -0,0 +1,47 @@
+// hrtree/arch/simd/shape_intersect_policy_impl.hpp header file
+//
+// Part of the Hilbert Rtree library.
+// Copyright (c) 2000-2014 Hanno Hildenbrandt
+//
+// This software is provided "as is" without express or implied warranty,
+// and with no claim as to its suitability for any purpose.
+
+#ifndef HRTREE_ARCH_SIMD_SHAPE_INTERSECT_POLICY_IMPL_HPP_INCLUDED
+#define HRTREE_ARCH_SIMD_SHAPE_INTERSECT_POLICY_IMPL_HPP_INCLUDED
+
+#include <hrtree/shape_intersect_policy.hpp>
+#include <hrtree/arch/simd/simd_aux.hpp>
+
+
+namespace hrtree { namespace detail {
+
+  inline __m128 sat_loadu(const float* p)    { return _mm_loadu_ps(p); }
+  inline __m128d sat_loadu(const double* p)  { return _mm_loadu_pd(p); }
+
+
+  // one lane per axis
+  template <typename simd_vec, typename T>
+  inline bool convex_sat_impl(simd_vec, const convex_shape<T>& s, T dx, T dy, T rx, T ry)
+  {
+    const int lanes = sizeof(simd_vec) / sizeof(T);
+    if (!s.bounds(dx, dy, rx, ry)) return false;
+    const simd_vec vdx = simd::set<simd_vec>::val(dx);
+    const simd_vec vdy = simd::set<simd_vec>::val(dy);
+    const simd_vec vrx = simd::set<simd_vec>::val(rx);
+    const simd_vec vry = simd::set<simd_vec>::val(ry);
+    const size_t n = s.nx.size();
+    for (size_t i = 0; i < n; i += lanes)
+    {
+      const simd_vec p = simd::add(simd::mul(vdx, sat_loadu(&s.nx[i])), simd::mul(vdy, sat_loadu(&s.ny[i])));
+      const simd_vec e = simd::add(simd::mul(vrx, sat_loadu(&s.ax[i])), simd::mul(vry, sat_loadu(&s.ay[i])));
+      const simd_vec cmp0 = simd::cmple(simd::sub(p, e), sat_loadu(&s.hi[i]));
+      const simd_vec cmp1 = simd::cmpge(simd::add(p, e), sat_loadu(&s.lo[i]));
+      if (((1 << lanes) - 1) != simd::movemask(simd::band(cmp0, cmp1))) return false;
+    }
+    return true;
+  }
+
+
+} }
+
+#endif
@@ -18,11 +18,12 @@ namespace hrtree { namespace simd {
       
 
   template <size_t Dim, typename V, size_t A> struct load_ {};
-  template <size_t A> struct load_<2, __m128, A>   { static inline __m128 apply(const void* p) { return _mm_castpd_ps(_mm_load_sd((const double*)p)); } };
+  // 64-bit moves through __m128i, which may alias the float data (unlike double).
+  template <size_t A> struct load_<2, __m128, A>   { static inline __m128 apply(const void* p) { return _mm_castsi128_ps(_mm_loadl_epi64((const __m128i*)p)); } };
 #ifdef HRTREE_HAS_AVX
   template <size_t A> struct load_<3, __m128, A>   { static inline __m128 apply(const void* p) { return _mm_maskload_ps((const float*)p, _mm_set_epi32(0,-1,-1,-1)); } };
 #else
-  template <size_t A> struct load_<3, __m128, A>   { static inline __m128 apply(const void* p) { return _mm_movelh_ps(_mm_castpd_ps(_mm_load_sd((const double*)p)), _mm_load_ss(((const float*)p) + 2)); } };
+  template <size_t A> struct load_<3, __m128, A>   { static inline __m128 apply(const void* p) { return _mm_movelh_ps(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i*)p)), _mm_load_ss(((const float*)p) + 2)); } };
 #endif
   template <size_t A> struct load_<4, __m128, A>   { static inline __m128 apply(const void* p) { return _mm_loadu_ps((const float*)p); } };
   template <>         struct load_<4, __m128, 16>  { static inline __m128 apply(const void* p) { return _mm_loadu_ps((const float*)p); } };
@@ -45,11 +46,11 @@ namespace hrtree { namespace simd {
 
 
   template <size_t Dim, typename V, size_t A> struct store_ {};
-  template <size_t A> struct store_<2, __m128, A>   { static inline void apply(void* p, __m128 x) { _mm_store_sd((double*)p, _mm_castps_pd(x)); } };
+  template <size_t A> struct store_<2, __m128, A>   { static inline void apply(void* p, __m128 x) { _mm_storel_epi64((__m128i*)p, _mm_castps_si128(x)); } };
 #ifdef HRTREE_HAS_AVX
   template <size_t A> struct store_<3, __m128, A>   { static inline void apply(void* p, __m128 x) { _mm_maskstore_ps((float*)p, _mm_set_epi32(0,-1,-1,-1), x); } };
 #else
-  template <size_t A> struct store_<3, __m128, A>   { static inline void apply(void* p, __m128 x) { _mm_store_sd((double*)p, _mm_castps_pd(x)); _mm_store_ss(((float*)p) + 2, _mm_movehl_ps(x, x)); } };
+  template <size_t A> struct store_<3, __m128, A>   { static inline void apply(void* p, __m128 x) { _mm_storel_epi64((__m128i*)p, _mm_castps_si128(x)); _mm_store_ss(((float*)p) + 2, _mm_movehl_ps(x, x)); } };
 //  template <size_t A> struct store_<3, __m128, A>   { static inline void apply(void* p, __m128 x) { _mm_maskmoveu_si128(_mm_castps_si128(x), _mm_set_epi32(-1,-1,-1,0), (char*)p); } };
 #endif
   template <size_t A> struct store_<4, __m128, A>   { static inline void apply(void* p, __m128 x) { _mm_storeu_ps((float*)p, x); } };
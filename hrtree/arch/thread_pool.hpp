@@ -0,0 +1,238 @@
+// hrtree/arch/thread_pool.hpp header file
+//
+// Part of the Hilbert Rtree library.
+// Copyright (c) 2000-2014 Hanno Hildenbrandt
+//
+// This software is provided "as is" without express or implied warranty,
+// and with no claim as to its suitability for any purpose.
+//
+// Persistent std::thread pool behind HRTREE_BACKEND_THREADS.
+// The workers are created once and spin, then sleep, between parallel
+// regions. A region wakes them instead of creating threads per call.
+
+
+#ifndef HRTREE_ARCH_THREAD_POOL_HPP_INCLUDED
+#define HRTREE_ARCH_THREAD_POOL_HPP_INCLUDED
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <hrtree/config.hpp>
+#include <hrtree/arch/select.hpp>     // _mm_pause
+
+
+namespace hrtree { namespace arch {
+
+
+  // Spin-wait hint
+  inline void cpu_relax()
+  {
+#if (defined(HRTREE_HAS_AVX) || defined(HRTREE_HAS_SSE2))
+    _mm_pause();
+#endif
+  }
+
+
+  // Spins briefly, yields the cpu afterwards.
+  class backoff
+  {
+  public:
+    backoff() : spins_(0) {}
+
+    void operator()()
+    {
+      if (spins_ < 64) { ++spins_; cpu_relax(); }
+      else std::this_thread::yield();
+    }
+
+    int spins() const { return spins_; }
+
+  private:
+    int spins_;
+  };
+
+
+  // Sense reversing barrier for a fixed number of threads.
+  class spin_barrier
+  {
+  public:
+    explicit spin_barrier(int n = 1) : n_(n), count_(0), gen_(0) {}
+
+    // Not thread safe, no thread shall wait.
+    void reset(int n) { n_ = n; count_.store(0, std::memory_order_relaxed); }
+
+    void wait()
+    {
+      const unsigned gen = gen_.load(std::memory_order_acquire);
+      if (count_.fetch_add(1, std::memory_order_acq_rel) == n_ - 1)
+      {
+        count_.store(0, std::memory_order_relaxed);
+        gen_.store(gen + 1, std::memory_order_release);
+      }
+      else
+      {
+        backoff bo;
+        while (gen_.load(std::memory_order_acquire) == gen) bo();
+      }
+    }
+
+  private:
+    int n_;
+    std::atomic<int> count_;
+    std::atomic<unsigned> gen_;
+  };
+
+
+  class thread_pool
+  {
+  public:
+    // num_threads includes the calling thread
+    explicit thread_pool(int num_threads) : job_(0), pending_(0), busy_(false), stop_(false)
+    {
+      for (int tid = 1; tid < num_threads; ++tid)
+      {
+        workers_.emplace_back([this, tid]() { worker(tid); });
+      }
+    }
+
+    ~thread_pool()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        job_.fetch_add(1, std::memory_order_release);
+      }
+      wake_.notify_all();
+      for (auto& w : workers_) w.join();
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    int num_threads() const { return int(workers_.size()) + 1; }
+
+    // Runs fun(tid, nt) on nt = min(numt, num_threads()) threads, tid 0 on
+    // the calling thread, and returns when all are done. The first exception
+    // thrown is rethrown here. Runs fun(0, 1) if the pool is busy, e.g. from
+    // a nested region or from another application thread.
+    template <typename Fun>
+    void run(int numt, Fun& fun)
+    {
+      const int nt = std::min(numt, num_threads());
+      bool idle = false;
+      if (nt <= 1 || in_region() || !busy_.compare_exchange_strong(idle, true, std::memory_order_acquire))
+      {
+        fun(0, 1);
+        return;
+      }
+      eptr_ = nullptr;
+      barrier_.reset(nt);
+      pending_.store(nt - 1, std::memory_order_relaxed);
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        invoke_ = &invoke<Fun>;
+        ctx_ = &fun;
+        nt_ = nt;
+        job_.fetch_add(1, std::memory_order_release);
+      }
+      wake_.notify_all();
+      region_flag() = true;
+      invoke<Fun>(this, &fun, 0, nt);
+      region_flag() = false;
+      backoff bo;
+      while (pending_.load(std::memory_order_acquire)) bo();
+      std::exception_ptr eptr = eptr_;
+      busy_.store(false, std::memory_order_release);
+      if (eptr) std::rethrow_exception(eptr);
+    }
+
+    // Barrier of the running region, only valid from inside fun.
+    void barrier() { barrier_.wait(); }
+
+    // True for the threads of a running region.
+    static bool in_region() { return region_flag(); }
+
+    // Pool shared by the library, hrtree_max_num_threads() threads.
+    static thread_pool& instance()
+    {
+      static thread_pool pool(hrtree_max_num_threads());
+      return pool;
+    }
+
+  private:
+    typedef void (*invoke_fun)(thread_pool*, void*, int, int);
+
+    static bool& region_flag()
+    {
+      static thread_local bool flag = false;
+      return flag;
+    }
+
+    template <typename Fun>
+    static void invoke(thread_pool* pool, void* ctx, int tid, int nt)
+    {
+      try
+      {
+        (*static_cast<Fun*>(ctx))(tid, nt);
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lock(pool->mutex_);
+        if (!pool->eptr_) pool->eptr_ = std::current_exception();
+      }
+    }
+
+    void worker(int tid)
+    {
+      region_flag() = true;
+      unsigned seen = 0;
+      for (;;)
+      {
+        // spin for a while, short regions follow each other closely
+        backoff bo;
+        while (job_.load(std::memory_order_acquire) == seen && bo.spins() < 64) bo();
+        invoke_fun fun;
+        void* ctx;
+        int nt;
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          wake_.wait(lock, [&]() { return job_.load(std::memory_order_relaxed) != seen; });
+          if (stop_) return;
+          seen = job_.load(std::memory_order_relaxed);
+          fun = invoke_;
+          ctx = ctx_;
+          nt = nt_;
+        }
+        if (tid < nt)
+        {
+          fun(this, ctx, tid, nt);
+          pending_.fetch_sub(1, std::memory_order_acq_rel);
+        }
+      }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::atomic<unsigned> job_;
+    std::atomic<int> pending_;
+    std::atomic<bool> busy_;
+    spin_barrier barrier_;
+    invoke_fun invoke_ = nullptr;
+    void* ctx_ = nullptr;
+    int nt_ = 0;
+    bool stop_;
+    std::exception_ptr eptr_;
+  };
+
+
+}
+
+using arch::thread_pool;
+
+}
+
+#endif
@@ -5,12 +5,17 @@
 //
 // This software is provided "as is" without express or implied warranty,
 // and with no claim as to its suitability for any purpose.
+//
+// Rtree without leaf level: level 0 holds one bounding volume per
+// bucket of LEAF_FANOUT consecutive items. Queries report every item of a
+// bucket that passes the cull policy, the caller does the final test.
 
 #ifndef HRTREE_COMPACT_RTREE_HPP
 #define HRTREE_COMPACT_RTREE_HPP
 
 #include <hrtree/rtree_base.hpp>
 #include <hrtree/mbr_build_policy.hpp>
+#include <hrtree/visitor.hpp>
 
 
 namespace hrtree {
@@ -19,38 +24,52 @@ namespace hrtree {
   template <
     typename BV,
     typename BP = mbr_build_policy<BV>,
-    size_t FANOUT = 8,
-    typename A = typename aligned_allocator< BV, HRTREE_ALIGNOF(BV) >
+    size_t NODE_FANOUT = 8,
+    typename A = aligned_allocator< BV, HRTREE_ALIGNOF(BV) >,
+    template <size_t, size_t> class L = level_layout,
+    size_t LEAF_FANOUT = NODE_FANOUT
   >
-  class compact_rtree : public rtree_base<BV, BP, FANOUT, A>
+  class compact_rtree : public rtree_base<BV, BP, NODE_FANOUT, A, L>
   {
-    typedef rtree_base<BV,BP,FANOUT,A> base_type;
-    using base_type::stack_element;
+    typedef rtree_base<BV, BP, NODE_FANOUT, A, L> base_type;
+    typedef typename base_type::stack_element stack_element;
 
   public:
-    using base_type::bv_align;
-    using base_type::bv_type;
-    using base_type::bv_reference;
-    using base_type::bv_iterator;
-    using base_type::const_bv_iterator;
-    using base_type::build_policy;
+    typedef typename base_type::bv_type bv_type;
+    typedef typename base_type::bv_reference bv_reference;
+    typedef typename base_type::bv_iterator bv_iterator;
+    typedef typename base_type::const_bv_iterator const_bv_iterator;
+    typedef typename base_type::build_policy build_policy;
+    typedef typename base_type::layout_type layout_type;
 
   public:
     compact_rtree(): elems_(0) {}
     ~compact_rtree() {}
+    compact_rtree(const compact_rtree& x) : base_type(x), elems_(x.elems_) {}
 
     compact_rtree& operator = (const compact_rtree& rhs) { base_type::operator=(rhs); elems_ = rhs.elems_; return *this; }
-    void swap(compact_rtree& rhs) { base_type::swap(static_cast<base_type&>(rhs)); }
-    void clear() { base_type::clear(); }
+    void swap(compact_rtree& rhs) { base_type::swap(static_cast<base_type&>(rhs)); std::swap(elems_, rhs.elems_); }
+    void clear() { base_type::clear(); elems_ = 0; }
+
+    compact_rtree(compact_rtree&& rhs) : base_type(std::move(rhs)), elems_(rhs.elems_) { rhs.elems_ = 0; }
+    compact_rtree& operator = (compact_rtree&& rhs) { base_type::operator=(std::move(rhs)); elems_ = rhs.elems_; rhs.elems_ = 0; return *this; }
+    void swap(compact_rtree&& rhs) { swap(static_cast<compact_rtree&>(rhs)); }
+
+    // Number of items, not buckets.
+    size_t elements() const { return elems_; }
 
-    compact_rtree(compact_rtree&& rhs) : base_type(std::move(rhs)) {}
-    compact_rtree& operator = (compact_rtree&& rhs) { base_type::operator=(std::move(rhs)); elems_ = rhs.elems_; return *this; }
-    void swap(compact_rtree&& rhs) { base_type::swap(std::move(rhs)); }
+    // Allocates the buckets for n items. Fill them with leaf_bv(bucket)
+    // and finish with build_hierarchy().
+    void build_index(size_t n)
+    {
+      elems_ = n;
+      base_type::build_index((n + LEAF_FANOUT - 1) / LEAF_FANOUT);
+    }
 
     template <typename FwdIt>
     void parallel_build(FwdIt first, FwdIt last)
     {
-      parallel_build(first, last, base_type::identity_conversion());
+      parallel_build(first, last, typename base_type::identity_conversion());
     }
 
     template <typename FwdIt, typename Conversion>
@@ -59,67 +78,71 @@ namespace hrtree {
     template <typename FwdIt>
     void build(FwdIt first, FwdIt last)
     {
-      build(first, last, base_type::identity_conversion());
+      build(first, last, typename base_type::identity_conversion());
     }
 
     template <typename FwdIt, typename Conversion>
     void build(FwdIt first, FwdIt last, Conversion conv);
 
+    // range_fun(i0, i1) for the items of each run of consecutive
+    // buckets passing cull_policy. i0 is a multiple of LEAF_FANOUT.
+    // range_fun and query_fun may return bool, false stops the query.
+    // Returns false if the query was stopped.
+    template <typename CullPolicy, typename RangeFun>
+    bool query_buckets(const CullPolicy& cull_policy, RangeFun& range_fun) const;
+
     template <typename FwdIt, typename CullPolicy, typename QueryFun>
-    void query(FwdIt cfirst, const CullPolicy& cull_policy, QueryFun& query_fun) const;
+    bool query(FwdIt cfirst, const CullPolicy& cull_policy, QueryFun& query_fun) const;
 
     template <typename CullPolicy, typename QueryFun>
-    void query(const CullPolicy& cull_policy, QueryFun& query_fun) const;
+    bool query(const CullPolicy& cull_policy, QueryFun& query_fun) const;
 
   private:
     size_t elems_;
   };
 
 
-  template <typename BV, typename BP, size_t FANOUT, typename A>
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
   template <typename FwdIt, typename Conversion>
-  void compact_rtree<BV,BP,FANOUT,A>::parallel_build(FwdIt first, FwdIt last, Conversion conv)
+  void compact_rtree<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::parallel_build(FwdIt first, FwdIt last, Conversion conv)
   {
-    elems_ = std::distance(first, last);
-    base_type::build_index((elems_ - 1 + FANOUT) / FANOUT);
+    build_index(std::distance(first, last));
 
-    // Construct leaf bounding volumes
-    const int L = (int)this->leaf_nodes();
-    const int N = (int)elems_;
-    build_policy bp;
-    const int numt = hrtree_max_num_threads();
-#   pragma omp parallel for num_threads(numt)
-    for (int i=0; i<L; ++i)
+    // Construct bucket bounding volumes
+    const std::ptrdiff_t B = static_cast<std::ptrdiff_t>(this->leaf_nodes());
+    const std::ptrdiff_t N = static_cast<std::ptrdiff_t>(elems_);
+    arch::parallel_for(std::ptrdiff_t(0), B, [&](std::ptrdiff_t i)
     {
+      build_policy bp;
+      FwdIt src(first);
+      std::advance(src, i * LEAF_FANOUT);
       auto dst = this->index_[0] + i;
-      this->alloc_.construct(&*dst, conv(*(first + i * FANOUT)));
-      const size_t F = std::min<size_t>(FANOUT, N - i * FANOUT);
-      for (size_t j=1; j<F; ++j)
+      this->alloc_.construct(&*dst, conv(*src));
+      const std::ptrdiff_t F = std::min<std::ptrdiff_t>(LEAF_FANOUT, N - i * LEAF_FANOUT);
+      for (std::ptrdiff_t j=1; j<F; ++j)
       {
-        bv_type bv(conv(*(first + i * FANOUT + j)));
+        bv_type bv(conv(*++src));
         bp(&bv, &bv + 1, &*dst);
       }
-    }
-
+    });
     base_type::parallel_build_hierarchy();
   }
 
 
-  template <typename BV, typename BP, size_t FANOUT, typename A>
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
   template <typename FwdIt, typename Conversion>
-  void compact_rtree<BV,BP,FANOUT,A>::build(FwdIt first, FwdIt last, Conversion conv)
+  void compact_rtree<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::build(FwdIt first, FwdIt last, Conversion conv)
   {
-    elems_ = std::distance(first, last);
-    base_type::build_index((elems_ - 1 + FANOUT) / FANOUT);
+    build_index(std::distance(first, last));
 
-    // Construct leaf bounding volumes
-    const size_t L = this->leaf_nodes();
-    bv_iterator dst(this->index_[0]);      
+    // Construct bucket bounding volumes
+    const size_t B = this->leaf_nodes();
+    bv_iterator dst(this->index_[0]);
     build_policy bp;
-    for (size_t i=0; i<L; ++i)
+    for (size_t i=0; i<B; ++i)
     {
       this->alloc_.construct(&*dst, conv(*first++));
-      const size_t F = std::min<size_t>(FANOUT, elems_ - i * FANOUT);
+      const size_t F = std::min<size_t>(LEAF_FANOUT, elems_ - i * LEAF_FANOUT);
       for (size_t j=1; j<F; ++j)
       {
         bv_type bv(conv(*first++));
@@ -131,102 +154,94 @@ namespace hrtree {
   }
 
 
-  template <typename BV, typename BP, size_t FANOUT, typename A>
-  template <typename FwdIt, typename CullPolicy, typename QueryFun>
-  void compact_rtree<BV,BP,FANOUT,A>::query(
-    FwdIt cfirst,
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
+  template <typename CullPolicy, typename RangeFun>
+  bool compact_rtree<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::query_buckets(
     const CullPolicy& cull_policy,
-    QueryFun& query_fun
+    RangeFun& range_fun
     ) const
   {
-    if (this->empty()) return;
+    if (this->empty()) return true;
     size_t level = base_type::height_ - 1;
     stack_element stack[base_type::MaxHeight];
-    stack[level] = base_type::stack_element(0,1);
+    stack[level] = stack_element(0, 1);
     while (level < base_type::height_)
     {
-      base_type::stack_element& s = stack[level];
-      const_bv_iterator first( index_[level] + s.first );
-      s.second = std::min(s.second, level_nodes(level));
-      for (; s.first < s.second; ++s.first)
+      stack_element& s = stack[level];
+      const_bv_iterator first(this->node(level, s.first));
+      s.second = std::min(s.second, this->level_nodes(level));
+      for (; s.first < s.second; this->advance(first, level, ++s.first))
       {
-        if (cull_policy(*first++))
+        if (cull_policy(*first))
         {
-          size_t next_level_first = s.first * FANOUT;
-          for (++s.first; s.first < s.second; ++s.first)
+          if (level > 0) this->prefetch_children(level, s.first);
+          const size_t F = (level > 0) ? NODE_FANOUT : LEAF_FANOUT;
+          size_t next_level_first = s.first * F;
+          for (this->advance(first, level, ++s.first); s.first < s.second; this->advance(first, level, ++s.first))
           {
-            if (!cull_policy(*first++))
+            if (!cull_policy(*first))
             {
               break;
             }
+            if (level > 0) this->prefetch_children(level, s.first);
           }
           if (level > 0)
           {
-            stack[--level] = base_type::stack_element(next_level_first, s.first * FANOUT);
+            stack[--level] = stack_element(next_level_first, s.first * F);
             goto descent;
           }
-          size_t i0 = next_level_first;
-          const size_t i1 = std::min(s.first * FANOUT, elems_); 
-          FwdIt it(cfirst);
-          std::advance(it, i0);
-          for (; i0 < i1; ++i0, ++it)
+          if (!invoke_visitor(range_fun, next_level_first, std::min(s.first * F, elems_)))
           {
-            query_fun(*it);
+            return false;
           }
         }
       }
       ++level;
-descent:
+    descent:
       ;
     }
+    return true;
+  }
+
+
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
+  template <typename FwdIt, typename CullPolicy, typename QueryFun>
+  bool compact_rtree<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::query(
+    FwdIt cfirst,
+    const CullPolicy& cull_policy,
+    QueryFun& query_fun
+    ) const
+  {
+    auto range_fun = [&](size_t i0, size_t i1)
+    {
+      FwdIt it(cfirst);
+      std::advance(it, i0);
+      for (; i0 < i1; ++i0, ++it)
+      {
+        if (!invoke_visitor(query_fun, *it)) return false;
+      }
+      return true;
+    };
+    return query_buckets(cull_policy, range_fun);
   }
 
 
-  template <typename BV, typename BP, size_t FANOUT, typename A>
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
   template <typename CullPolicy, typename QueryFun>
-  void compact_rtree<BV, BP, FANOUT, A>::query(
+  bool compact_rtree<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::query(
     const CullPolicy& cull_policy,
     QueryFun& query_fun
     ) const
   {
-    if (this->empty()) return;
-    size_t level = base_type::height_ - 1;
-    stack_element stack[base_type::MaxHeight];
-    stack[level] = base_type::stack_element(0, 1);
-    while (level < base_type::height_)
+    auto range_fun = [&](size_t i0, size_t i1)
     {
-      base_type::stack_element& s = stack[level];
-      const_bv_iterator first(this->index_[level] + s.first);
-      s.second = std::min(s.second, this->level_nodes(level));
-      for (; s.first < s.second; ++s.first)
+      for (; i0 < i1; ++i0)
       {
-        if (cull_policy(*first++))
-        {
-          size_t next_level_first = s.first * FANOUT;
-          for (++s.first; s.first < s.second; ++s.first)
-          {
-            if (!cull_policy(*first++))
-            {
-              break;
-            }
-          }
-          if (level > 0)
-          {
-            stack[--level] = base_type::stack_element(next_level_first, s.first * FANOUT);
-            goto descent;
-          }
-          size_t i0 = next_level_first;
-          const size_t i1 = std::min(s.first * FANOUT, elems_);
-          for (; i0 < i1; ++i0)
-          {
-            query_fun(i0);
-          }
-        }
+        if (!invoke_visitor(query_fun, i0)) return false;
       }
-      ++level;
-    descent:
-      ;
-    }
+      return true;
+    };
+    return query_buckets(cull_policy, range_fun);
   }
 
 }  // namespace hrtree
@@ -18,14 +18,56 @@
 //  #define HRTREE_NO_OPNENMP
 #endif
 
-#if defined(_OPENMP) && !defined(HRTREE_NO_OPENMP)
+// Execution backend of the parallel algorithms (hrtree/arch/parallel.hpp)
+// HRTREE_BACKEND_OPENMP:  OpenMP, requires compiler support (/openmp, -fopenmp)
+// HRTREE_BACKEND_THREADS: persistent std::thread pool
+// HRTREE_BACKEND_SERIAL:  single threaded
+// Default: OpenMP if enabled and not disabled by HRTREE_NO_OPENMP,
+// the thread pool otherwise.
+#define HRTREE_BACKEND_SERIAL 0
+#define HRTREE_BACKEND_OPENMP 1
+#define HRTREE_BACKEND_THREADS 2
+
+#ifndef HRTREE_PARALLEL_BACKEND
+  #if defined(_OPENMP) && !defined(HRTREE_NO_OPENMP)
+    #define HRTREE_PARALLEL_BACKEND HRTREE_BACKEND_OPENMP
+  #else
+    #define HRTREE_PARALLEL_BACKEND HRTREE_BACKEND_THREADS
+  #endif
+#endif
+
+// Upper limit of the number of threads used by the library.
+// Thread scratch space is sized at runtime.
+#ifndef HRTREE_OMP_MAX_THREADS
+  #define HRTREE_OMP_MAX_THREADS 1024
+#endif
+
+#if defined(_OPENMP)
   #include <omp.h>
-  #ifndef HRTREE_OMP_MAX_THREADS
-    #define HRTREE_OMP_MAX_THREADS 32
+#else
+  #include <hrtree/arch/omp_stub.hpp>
+#endif
+
+#if HRTREE_PARALLEL_BACKEND == HRTREE_BACKEND_OPENMP
+  #ifndef _OPENMP
+    #error HRTREE_BACKEND_OPENMP requires OpenMP
   #endif
   inline int hrtree_max_num_threads() { return std::min<int>(omp_get_max_threads(), HRTREE_OMP_MAX_THREADS); }
+#elif HRTREE_PARALLEL_BACKEND == HRTREE_BACKEND_THREADS
+  #include <thread>
+  #include <cstdlib>
+  // Size of the thread pool: environment variable HRTREE_NUM_THREADS
+  // or the number of hardware threads.
+  inline int hrtree_max_num_threads()
+  {
+    static const int numt = []() {
+      const char* env = std::getenv("HRTREE_NUM_THREADS");
+      const int n = (env && std::atoi(env) > 0) ? std::atoi(env) : (int)std::thread::hardware_concurrency();
+      return std::max<int>(1, std::min<int>(n, HRTREE_OMP_MAX_THREADS));
+    }();
+    return numt;
+  }
 #else
-  #include <hrtree/arch/omp_stub.hpp>
   #undef HRTREE_OMP_MAX_THREADS
   #define HRTREE_OMP_MAX_THREADS 1
   inline int hrtree_max_num_threads() { return 1; }
@@ -33,6 +75,36 @@
 
 #define HRTREE_PARALLEL_PARTITION_BLOCK 256
 
+// Default number of cache lines of a child block that are prefetched
+// when a node passes the cull test during traversal. 0: no prefetch.
+#ifndef HRTREE_PREFETCH_LINES
+  #define HRTREE_PREFETCH_LINES 2
+#endif
+
+#define HRTREE_CACHELINE_SIZE 64
+
+// Subtrees that fit into half of the L2 cache are built in one go.
+#ifndef HRTREE_L2_CACHE_SIZE
+  #define HRTREE_L2_CACHE_SIZE (256 * 1024)
+#endif
+
+// huge_page_allocator: allocations of at least HRTREE_HUGE_PAGE_THRESHOLD
+// bytes are backed by huge pages of HRTREE_HUGE_PAGE_SIZE bytes.
+// Linux: transparent huge pages (madvise) unless HRTREE_HUGE_PAGE_HUGETLB
+// is defined, which tries the reserved hugetlbfs pool (MAP_HUGETLB) first.
+// Windows: large pages if the process holds SeLockMemoryPrivilege.
+#ifndef HRTREE_HUGE_PAGE_SIZE
+  #define HRTREE_HUGE_PAGE_SIZE (size_t(2) << 20)
+#endif
+
+#ifndef HRTREE_HUGE_PAGE_THRESHOLD
+  #define HRTREE_HUGE_PAGE_THRESHOLD HRTREE_HUGE_PAGE_SIZE
+#endif
+
+#ifndef HRTREE_HUGE_PAGE_HUGETLB
+// #define HRTREE_HUGE_PAGE_HUGETLB
+#endif
+
 #ifndef HRTREE_PARALLEL_ALIGNED_CONSTRUCT
 // #define HRTREE_PARALLEL_ALIGNED_CONSTRUCT
 #endif
@@ -15,28 +15,21 @@
 
 namespace hrtree { namespace detail {
 
-namespace {
-
   struct gray2d_tab
   {
-    static const unsigned char derived_key[2][4];
-    static const unsigned char next_state[2][4];
-  };
-
-  const unsigned char gray2d_tab::derived_key[2][4] =
-  {
-    {0,3,1,2},
-    {2,3,1,0}
+    static constexpr unsigned char derived_key[2][4] =
+    {
+      {0,3,1,2},
+      {2,3,1,0}
+    };
+
+    static constexpr unsigned char next_state[2][4] =
+    {
+      {0,1,0,1},
+      {1,0,1,0}
+    };
   };
 
-  const unsigned char gray2d_tab::next_state[2][4] =
-  {
-    {0,1,0,1},
-    {1,0,1,0}
-  };
-
-} // anonymous namespace
-
 
   typedef ::hrtree::detail::table_fsm< gray2d_tab > gray2d_fsm;
 
@@ -15,32 +15,25 @@
 
 namespace hrtree { namespace detail {
 
-namespace {
-
   struct gray3d_tab
   {
-    static const unsigned char derived_key[4][8];
-    static const unsigned char next_state[4][8];
-  };
-
-  const unsigned char gray3d_tab::derived_key[4][8] =
-  {
-    {0,1,3,2,6,7,5,4},
-    {5,4,6,7,3,2,0,1},
-    {3,2,0,1,5,4,6,7},
-    {6,7,5,4,0,1,3,2}
+    static constexpr unsigned char derived_key[4][8] =
+    {
+      {0,1,3,2,6,7,5,4},
+      {5,4,6,7,3,2,0,1},
+      {3,2,0,1,5,4,6,7},
+      {6,7,5,4,0,1,3,2}
+    };
+
+    static constexpr unsigned char next_state[4][8] =
+    {
+      {0,1,2,3,3,2,1,0},
+      {1,0,3,2,2,3,0,1},
+      {2,3,0,1,1,0,3,2},
+      {3,2,1,0,0,1,2,3}
+    };
   };
 
-  const unsigned char gray3d_tab::next_state[4][8] =
-  {
-    {0,1,2,3,3,2,1,0},
-    {1,0,3,2,2,3,0,1},
-    {2,3,0,1,1,0,3,2},
-    {3,2,1,0,0,1,2,3}
-  };
-
-} // anonymous namespace
-
 
   typedef ::hrtree::detail::table_fsm< gray3d_tab > gray3d_fsm;
 
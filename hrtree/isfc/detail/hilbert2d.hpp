@@ -15,32 +15,25 @@
 
 namespace hrtree { namespace detail {
 
-namespace {
-
   struct hilbert2d_tab
   {
-    static const unsigned char derived_key[4][4];
-    static const unsigned char next_state[4][4];
-  };
-
-  const unsigned char hilbert2d_tab::derived_key[4][4] =
-  {
-    {0,1,3,2},
-    {0,3,1,2},
-    {2,1,3,0},
-    {2,3,1,0}
+    static constexpr unsigned char derived_key[4][4] =
+    {
+      {0,1,3,2},
+      {0,3,1,2},
+      {2,1,3,0},
+      {2,3,1,0}
+    };
+
+    static constexpr unsigned char next_state[4][4] =
+    {
+      {1,0,2,0},
+      {0,3,1,1},
+      {2,2,0,3},
+      {3,1,3,2}
+    };
   };
 
-  const unsigned char hilbert2d_tab::next_state[4][4] =
-  {
-    {1,0,2,0},
-    {0,3,1,1},
-    {2,2,0,3},
-    {3,1,3,2}
-  };
-
-} // anonymous namespace
-
 
   typedef ::hrtree::detail::table_fsm< hilbert2d_tab > hilbert2d_fsm;
 
@@ -15,88 +15,81 @@
 
 namespace hrtree { namespace detail {
 
-namespace {
-
-  struct hilbert4d_tab 
+  struct hilbert4d_tab
   {
-    static const unsigned char derived_key[32][16];
-    static const unsigned char next_state[32][16];
-  };
+    static constexpr unsigned char derived_key[32][16] =
+    {
+      {0,1,3,2,7,6,4,5,15,14,12,13,8,9,11,10},
+      {0,15,1,14,3,12,2,13,7,8,6,9,4,11,5,10},
+      {0,7,15,8,1,6,14,9,3,4,12,11,2,5,13,10},
+      {4,7,3,0,11,8,12,15,5,6,2,1,10,9,13,14},
+      {6,7,5,4,1,0,2,3,9,8,10,11,14,15,13,12},
+      {14,9,1,6,15,8,0,7,13,10,2,5,12,11,3,4},
+      {8,7,9,6,11,4,10,5,15,0,14,1,12,3,13,2},
+      {12,11,3,4,13,10,2,5,15,8,0,7,14,9,1,6},
+      {10,9,13,14,5,6,2,1,11,8,12,15,4,7,3,0},
+      {2,5,13,10,3,4,12,11,1,6,14,9,0,7,15,8},
+      {8,15,7,0,9,14,6,1,11,12,4,3,10,13,5,2},
+      {0,3,7,4,15,12,8,11,1,2,6,5,14,13,9,10},
+      {12,15,11,8,3,0,4,7,13,14,10,9,2,1,5,6},
+      {4,5,7,6,3,2,0,1,11,10,8,9,12,13,15,14},
+      {10,11,9,8,13,12,14,15,5,4,6,7,2,3,1,0},
+      {6,9,7,8,5,10,4,11,1,14,0,15,2,13,3,12},
+      {14,13,9,10,1,2,6,5,15,12,8,11,0,3,7,4},
+      {2,1,5,6,13,14,10,9,3,0,4,7,12,15,11,8},
+      {6,1,9,14,7,0,8,15,5,2,10,13,4,3,11,12},
+      {8,11,15,12,7,4,0,3,9,10,14,13,6,5,1,2},
+      {14,15,13,12,9,8,10,11,1,0,2,3,6,7,5,4},
+      {12,13,15,14,11,10,8,9,3,2,0,1,4,5,7,6},
+      {2,3,1,0,5,4,6,7,13,12,14,15,10,11,9,8},
+      {4,11,5,10,7,8,6,9,3,12,2,13,0,15,1,14},
+      {10,5,11,4,9,6,8,7,13,2,12,3,14,1,15,0},
+      {14,1,15,0,13,2,12,3,9,6,8,7,10,5,11,4},
+      {12,3,13,2,15,0,14,1,11,4,10,5,8,7,9,6},
+      {2,13,3,12,1,14,0,15,5,10,4,11,6,9,7,8},
+      {4,3,11,12,5,2,10,13,7,0,8,15,6,1,9,14},
+      {6,5,1,2,9,10,14,13,7,4,0,3,8,11,15,12},
+      {10,13,5,2,11,12,4,3,9,14,6,1,8,15,7,0},
+      {8,9,11,10,15,14,12,13,7,6,4,5,0,1,3,2},
+    };
 
-  const unsigned char hilbert4d_tab::derived_key[32][16] =
-  {
-    {0,1,3,2,7,6,4,5,15,14,12,13,8,9,11,10},
-    {0,15,1,14,3,12,2,13,7,8,6,9,4,11,5,10},
-    {0,7,15,8,1,6,14,9,3,4,12,11,2,5,13,10},
-    {4,7,3,0,11,8,12,15,5,6,2,1,10,9,13,14},
-    {6,7,5,4,1,0,2,3,9,8,10,11,14,15,13,12},
-    {14,9,1,6,15,8,0,7,13,10,2,5,12,11,3,4},
-    {8,7,9,6,11,4,10,5,15,0,14,1,12,3,13,2},
-    {12,11,3,4,13,10,2,5,15,8,0,7,14,9,1,6},
-    {10,9,13,14,5,6,2,1,11,8,12,15,4,7,3,0},
-    {2,5,13,10,3,4,12,11,1,6,14,9,0,7,15,8},
-    {8,15,7,0,9,14,6,1,11,12,4,3,10,13,5,2},
-    {0,3,7,4,15,12,8,11,1,2,6,5,14,13,9,10},
-    {12,15,11,8,3,0,4,7,13,14,10,9,2,1,5,6},
-    {4,5,7,6,3,2,0,1,11,10,8,9,12,13,15,14},
-    {10,11,9,8,13,12,14,15,5,4,6,7,2,3,1,0},
-    {6,9,7,8,5,10,4,11,1,14,0,15,2,13,3,12},
-    {14,13,9,10,1,2,6,5,15,12,8,11,0,3,7,4},
-    {2,1,5,6,13,14,10,9,3,0,4,7,12,15,11,8},
-    {6,1,9,14,7,0,8,15,5,2,10,13,4,3,11,12},
-    {8,11,15,12,7,4,0,3,9,10,14,13,6,5,1,2},
-    {14,15,13,12,9,8,10,11,1,0,2,3,6,7,5,4},
-    {12,13,15,14,11,10,8,9,3,2,0,1,4,5,7,6},
-    {2,3,1,0,5,4,6,7,13,12,14,15,10,11,9,8},
-    {4,11,5,10,7,8,6,9,3,12,2,13,0,15,1,14},
-    {10,5,11,4,9,6,8,7,13,2,12,3,14,1,15,0},
-    {14,1,15,0,13,2,12,3,9,6,8,7,10,5,11,4},
-    {12,3,13,2,15,0,14,1,11,4,10,5,8,7,9,6},
-    {2,13,3,12,1,14,0,15,5,10,4,11,6,9,7,8},
-    {4,3,11,12,5,2,10,13,7,0,8,15,6,1,9,14},
-    {6,5,1,2,9,10,14,13,7,4,0,3,8,11,15,12},
-    {10,13,5,2,11,12,4,3,9,14,6,1,8,15,7,0},
-    {8,9,11,10,15,14,12,13,7,6,4,5,0,1,3,2},
+    static constexpr unsigned char next_state[32][16] =
+    {
+      {1,2,3,2,4,5,3,5,6,7,8,7,4,9,8,9},
+      {2,10,11,12,13,14,11,12,15,15,16,17,13,14,16,17},
+      {11,18,19,18,0,20,21,22,23,23,24,24,0,20,21,22},
+      {7,17,7,22,9,17,9,14,1,1,25,25,26,26,27,27},
+      {10,0,10,19,18,26,18,19,28,0,28,29,30,23,30,29},
+      {31,4,13,14,11,10,19,10,31,4,13,14,6,6,15,15},
+      {25,25,11,12,13,14,11,12,7,28,16,17,13,14,16,17},
+      {26,26,27,27,0,20,21,22,16,30,29,30,0,20,21,22},
+      {6,6,15,15,23,23,24,24,2,12,2,22,5,12,5,14},
+      {31,4,13,14,1,1,25,25,31,4,13,14,16,28,29,28},
+      {5,12,5,3,0,20,21,22,23,23,24,24,0,20,21,22},
+      {0,28,29,28,31,30,29,30,1,1,25,25,26,26,27,27},
+      {7,20,7,8,9,4,9,8,1,1,25,25,26,26,27,27},
+      {12,2,22,2,12,5,27,5,17,7,22,7,17,9,24,9},
+      {10,11,10,21,18,11,18,27,28,16,28,21,30,16,30,24},
+      {19,3,1,1,19,3,31,4,29,8,7,28,29,8,31,4},
+      {6,6,15,15,23,23,24,24,0,10,19,10,31,18,19,18},
+      {6,6,15,15,23,23,24,24,2,20,2,3,5,4,5,3},
+      {31,4,13,14,2,12,2,3,31,4,13,14,6,6,15,15},
+      {16,28,21,28,16,30,13,30,1,1,25,25,26,26,27,27},
+      {10,1,10,19,18,31,18,19,28,6,28,29,30,31,30,29},
+      {12,2,25,2,12,5,14,5,17,7,15,7,17,9,14,9},
+      {10,11,10,25,18,11,18,13,28,16,28,15,30,16,30,13},
+      {21,22,11,12,27,27,11,12,21,22,16,17,9,30,16,17},
+      {19,3,0,20,19,3,26,26,29,8,0,20,29,8,9,30},
+      {19,3,2,10,19,3,31,4,29,8,6,6,29,8,31,4},
+      {21,22,11,12,5,18,11,12,21,22,16,17,24,24,16,17},
+      {19,3,0,20,19,3,5,18,29,8,0,20,29,8,23,23},
+      {26,26,27,27,0,20,21,22,9,17,9,8,0,20,21,22},
+      {6,6,15,15,23,23,24,24,11,10,21,10,11,18,13,18},
+      {31,4,13,14,1,1,25,25,31,4,13,14,7,17,7,8},
+      {20,2,3,2,26,5,3,5,20,7,8,7,23,9,8,9},
+    };
   };
 
-  const unsigned char hilbert4d_tab::next_state[32][16] =
-  {
-    {1,2,3,2,4,5,3,5,6,7,8,7,4,9,8,9},
-    {2,10,11,12,13,14,11,12,15,15,16,17,13,14,16,17},
-    {11,18,19,18,0,20,21,22,23,23,24,24,0,20,21,22},
-    {7,17,7,22,9,17,9,14,1,1,25,25,26,26,27,27},
-    {10,0,10,19,18,26,18,19,28,0,28,29,30,23,30,29},
-    {31,4,13,14,11,10,19,10,31,4,13,14,6,6,15,15},
-    {25,25,11,12,13,14,11,12,7,28,16,17,13,14,16,17},
-    {26,26,27,27,0,20,21,22,16,30,29,30,0,20,21,22},
-    {6,6,15,15,23,23,24,24,2,12,2,22,5,12,5,14},
-    {31,4,13,14,1,1,25,25,31,4,13,14,16,28,29,28},
-    {5,12,5,3,0,20,21,22,23,23,24,24,0,20,21,22},
-    {0,28,29,28,31,30,29,30,1,1,25,25,26,26,27,27},
-    {7,20,7,8,9,4,9,8,1,1,25,25,26,26,27,27},
-    {12,2,22,2,12,5,27,5,17,7,22,7,17,9,24,9},
-    {10,11,10,21,18,11,18,27,28,16,28,21,30,16,30,24},
-    {19,3,1,1,19,3,31,4,29,8,7,28,29,8,31,4},
-    {6,6,15,15,23,23,24,24,0,10,19,10,31,18,19,18},
-    {6,6,15,15,23,23,24,24,2,20,2,3,5,4,5,3},
-    {31,4,13,14,2,12,2,3,31,4,13,14,6,6,15,15},
-    {16,28,21,28,16,30,13,30,1,1,25,25,26,26,27,27},
-    {10,1,10,19,18,31,18,19,28,6,28,29,30,31,30,29},
-    {12,2,25,2,12,5,14,5,17,7,15,7,17,9,14,9},
-    {10,11,10,25,18,11,18,13,28,16,28,15,30,16,30,13},
-    {21,22,11,12,27,27,11,12,21,22,16,17,9,30,16,17},
-    {19,3,0,20,19,3,26,26,29,8,0,20,29,8,9,30},
-    {19,3,2,10,19,3,31,4,29,8,6,6,29,8,31,4},
-    {21,22,11,12,5,18,11,12,21,22,16,17,24,24,16,17},
-    {19,3,0,20,19,3,5,18,29,8,0,20,29,8,23,23},
-    {26,26,27,27,0,20,21,22,9,17,9,8,0,20,21,22},
-    {6,6,15,15,23,23,24,24,11,10,21,10,11,18,13,18},
-    {31,4,13,14,1,1,25,25,31,4,13,14,7,17,7,8},
-    {20,2,3,2,26,5,3,5,20,7,8,7,23,9,8,9},
-  };
-
-} // anonymous namespace
-
   
   typedef ::hrtree::detail::table_fsm< hilbert4d_tab > hilbert4d_fsm;
 
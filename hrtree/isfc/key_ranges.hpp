@@ -0,0 +1,160 @@
+// hrtree/isfc/key_ranges.hpp header file
+//
+// Part of the Hilbert Rtree library.
+// Copyright (c) 2000-2014 Hanno Hildenbrandt
+//
+// This software is provided "as is" without express or implied warranty,
+// and with no claim as to its suitability for any purpose.
+//
+// Decomposition of a box into key intervals along the curve of a key.
+// The curve cells are refined top-down through the key's FSM, so it
+// works for Hilbert, Gray and Morton keys alike. For Morton keys the
+// result equals a BIGMIN/LITMAX walk.
+
+
+#ifndef HRTREE_ISFC_KEY_RANGES_HPP_INCLUDED
+#define HRTREE_ISFC_KEY_RANGES_HPP_INCLUDED
+
+#include <cstdint>
+#include <algorithm>
+#include <hrtree/isfc/key.hpp>
+#include <hrtree/visitor.hpp>
+
+
+namespace hrtree {
+
+  namespace detail {
+
+
+    // Merges adjacent intervals before passing them on.
+    template <typename Fun>
+    class key_range_sink
+    {
+    public:
+      explicit key_range_sink(Fun& fun) : fun_(fun), first_(0), last_(0) {}
+
+      // false if fun asked to stop
+      bool operator()(std::uint64_t first, std::uint64_t last)
+      {
+        bool go = true;
+        if (first != last_)
+        {
+          go = flush();
+          first_ = first;
+        }
+        last_ = last;
+        return go;
+      }
+
+      bool flush()
+      {
+        const bool go = (first_ == last_) || invoke_visitor(fun_, first_, last_);
+        first_ = last_;
+        return go;
+      }
+
+    private:
+      Fun& fun_;
+      std::uint64_t first_, last_;
+    };
+
+
+    template <typename Key, typename Sink>
+    bool key_ranges_aux(typename Key::fsm_type fsm,
+                        const typename Key::arg_type* cell,
+                        int depth,
+                        std::uint64_t prefix,
+                        const typename Key::arg_type* lo,
+                        const typename Key::arg_type* hi,
+                        int boxes,
+                        int resolution,
+                        Sink& sink)
+    {
+      typedef typename Key::arg_type arg_type;
+      typedef typename Key::fsm_type fsm_type;
+      static const int children = 1 << Key::dim;
+
+      // children in curve order: n_point and fsm state after the step
+      unsigned n_points[children];
+      fsm_type states[children];
+      for (unsigned n_point = 0; n_point < unsigned(children); ++n_point)
+      {
+        fsm_type f(fsm);
+        const unsigned digit = f(n_point);
+        n_points[digit] = n_point;
+        states[digit] = f;
+      }
+      const int shift = Key::order - depth - 1;   // child cell extent 2^shift
+      const std::uint64_t span = std::uint64_t(1) << (Key::dim * shift);
+      for (int digit = 0; digit < children; ++digit)
+      {
+        arg_type child[Key::dim], child_hi[Key::dim];
+        for (int d = 0; d < Key::dim; ++d)
+        {
+          child[d] = cell[d] | (arg_type((n_points[digit] >> d) & 1) << shift);
+          child_hi[d] = child[d] + ((arg_type(1) << shift) - 1);
+        }
+        bool overlaps = false, inside = false;
+        for (int b = 0; b < boxes; ++b)
+        {
+          const arg_type* blo = lo + b * Key::dim;
+          const arg_type* bhi = hi + b * Key::dim;
+          bool o = true, i = true;
+          for (int d = 0; d < Key::dim; ++d)
+          {
+            o = o && (child[d] <= bhi[d]) && (blo[d] <= child_hi[d]);
+            i = i && (blo[d] <= child[d]) && (child_hi[d] <= bhi[d]);
+          }
+          overlaps = overlaps || o;
+          inside = inside || i;
+        }
+        if (!overlaps) continue;
+        const std::uint64_t child_prefix = (prefix << Key::dim) | std::uint64_t(digit);
+        const bool go = (inside || depth + 1 >= resolution)
+          ? sink(child_prefix * span, (child_prefix + 1) * span)
+          : key_ranges_aux<Key>(states[digit], child, depth + 1, child_prefix, lo, hi, boxes, resolution, sink);
+        if (!go) return false;
+      }
+      return true;
+    }
+
+  }
+
+
+  // Calls fun(first, last) for ascending, disjoint key intervals
+  // [first, last) that cover the union of boxes [lo, hi] (inclusive, in
+  // key arguments). Box b is lo[b * dim, (b + 1) * dim), hi likewise.
+  // Refinement stops at curve depth resolution, i.e. cells of
+  // 2^(order - resolution) arguments per dimension. Boundary cells at
+  // that depth are reported as a whole, the cover is conservative.
+  // fun may return bool, false stops. Returns false if stopped.
+  template <typename Key, typename Fun>
+  inline bool key_ranges(const typename Key::arg_type* lo,
+                         const typename Key::arg_type* hi,
+                         int boxes,
+                         int resolution,
+                         Fun fun)
+  {
+    static_assert(Key::key_bits < 64, "key_ranges: key doesn't fit into 64 bit");
+    resolution = std::max(1, std::min(resolution, int(Key::order)));
+    typename Key::arg_type cell[Key::dim] = {};
+    detail::key_range_sink<Fun> sink(fun);
+    return detail::key_ranges_aux<Key>(typename Key::fsm_type(), cell, 0, 0, lo, hi, boxes, resolution, sink)
+      && sink.flush();
+  }
+
+
+  // Single box [lo, hi].
+  template <typename Key, typename Fun>
+  inline bool key_ranges(const typename Key::arg_type* lo,
+                         const typename Key::arg_type* hi,
+                         int resolution,
+                         Fun fun)
+  {
+    return key_ranges<Key>(lo, hi, 1, resolution, fun);
+  }
+
+}
+
+
+#endif
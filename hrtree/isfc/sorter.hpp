@@ -11,6 +11,7 @@
 
 #include <utility>
 #include <hrtree/config.hpp>
+#include <hrtree/arch/parallel.hpp>
 #include <hrtree/util/radix_sort.hpp>
 #include <hrtree/util/parallel_radix_sort.hpp>
 #include <hrtree/util/parallel_quick_sort.hpp>
@@ -44,13 +45,11 @@ namespace isfc {
     template <typename IIt, typename OIt, typename KEYGEN>
     inline void gen_key_token(IIt src, OIt dst, const int N, const KEYGEN& keygen)
     {
-      const int numt = hrtree_max_num_threads();
-#     pragma omp parallel for firstprivate(src, dst) schedule(static) num_threads(numt)
-      for (int i=0; i<N; ++i)
+      hrtree::arch::parallel_for(0, N, [&](int i)
       {
         (dst + i)->first = keygen(*(src + i));
         (dst + i)->second = (unsigned)i;
-      }
+      });
     }
 
   }
@@ -0,0 +1,59 @@
+// hrtree/layout_policy.hpp header file
+//
+// Part of the Hilbert Rtree library.
+// Copyright (c) 2000-2014 Hanno Hildenbrandt
+//
+// This software is provided "as is" without express or implied warranty,
+// and with no claim as to its suitability for any purpose.
+
+#ifndef HRTREE_LAYOUT_POLICY_HPP_INCLUDED
+#define HRTREE_LAYOUT_POLICY_HPP_INCLUDED
+
+#include <cstddef>
+#include <hrtree/config.hpp>
+
+
+namespace hrtree {
+
+  // A layout policy maps the logical position of a node, (level, i) with
+  // level 0 holding the leaves, to a physical slot in the node array of
+  // rtree_base. All layouts share two invariants the traversals rely on:
+  //   - the leaves occupy the slots [0, level_nodes(0)) in order.
+  //   - the FANOUT children of a node are stored in consecutive slots.
+  //
+  // init() returns the number of slots, which may exceed the number of
+  // nodes; rtree_base only constructs, copies and destroys the slots
+  // of nodes. contiguous == true promises that a whole level is stored
+  // in order, i.e. slot(level, i + 1) == slot(level, i) + 1.
+
+
+  // Classic level by level layout: [leaves][level 1]...[root]
+  template <size_t FANOUT, size_t MAX_HEIGHT>
+  class level_layout
+  {
+  public:
+    static const bool contiguous = true;
+
+    level_layout() : offs_() {}
+
+    // Returns the number of slots required for the given node count per level.
+    size_t init(const size_t* count, size_t height)
+    {
+      offs_[0] = 0;
+      size_t level = 0;
+      for (; level < height; ++level) offs_[level + 1] = offs_[level] + count[level];
+      for (; level < MAX_HEIGHT; ++level) offs_[level + 1] = offs_[level];
+      return offs_[height];
+    }
+
+    size_t level_nodes(size_t level) const { return offs_[level + 1] - offs_[level]; }
+    size_t slot(size_t level, size_t i) const { return offs_[level] + i; }
+
+  private:
+    size_t offs_[MAX_HEIGHT + 1];
+  };
+
+}
+
+
+#endif
@@ -14,6 +14,9 @@
 #include <exception>
 #include <type_traits>
 #include <hrtree/config.hpp>
+#ifdef HRTREE_PARALLEL_ALIGNED_CONSTRUCT
+  #include <hrtree/arch/parallel.hpp>
+#endif
 
 
 namespace hrtree { namespace memory {
@@ -181,6 +184,20 @@ namespace hrtree { namespace memory {
   };
 
 
+  // Size of the pages backing a block of count elements from A.
+  template <typename A, typename enable = void>
+  struct allocator_page_size
+  {
+    static size_t get(size_t) { return 4096; }
+  };
+
+  template <typename A>
+  struct allocator_page_size<A, typename std::enable_if< A::allocator_has_page_size::value >::type > 
+  { 
+    static size_t get(size_t count) { return A::page_size(count); }
+  };
+
+
   template <typename T, typename RaIt>
   typename std::enable_if< std::is_trivially_constructible<T>::value >::type 
   inline aligned_default_construct(RaIt, size_t)
@@ -192,11 +209,14 @@ namespace hrtree { namespace memory {
   inline aligned_default_construct(RaIt it, const size_t N)
   {
 #ifdef HRTREE_PARALLEL_ALIGNED_CONSTRUCT
-    const int numt = hrtree_max_num_threads();
-#   pragma omp parallel for if(N>500) firstprivate(it) schedule(static) num_threads(numt)
-#endif
-    for (int i=0; i<(int)N; ++i)
+    arch::parallel_for(std::ptrdiff_t(0), (std::ptrdiff_t)N, [&](std::ptrdiff_t i)
+    {
+      ::new((T*)&(char&)(*(it + i))) T();
+    }, hrtree_max_num_threads(), N > 500);
+#else
+    for (std::ptrdiff_t i=0; i<(std::ptrdiff_t)N; ++i)
       ::new((T*)&(char&)(*(it + i))) T();
+#endif
   }
 
   template <typename T, typename RaIt>
@@ -209,22 +229,28 @@ namespace hrtree { namespace memory {
   inline void aligned_construct(RaIt it, const size_t N, const T& val)
   {
 #ifdef HRTREE_PARALLEL_ALIGNED_CONSTRUCT
-    const int numt = hrtree_max_num_threads();
-#   pragma omp parallel if(N>500) for firstprivate(it) schedule(static) num_threads(numt)
-#endif
-    for (int i=0; i<(int)N; ++i)
+    arch::parallel_for(std::ptrdiff_t(0), (std::ptrdiff_t)N, [&](std::ptrdiff_t i)
+    {
+      ::new((T*)&(char&)(*(it + i))) T(val);
+    }, hrtree_max_num_threads(), N > 500);
+#else
+    for (std::ptrdiff_t i=0; i<(std::ptrdiff_t)N; ++i)
       ::new((T*)&(char&)(*(it + i))) T(val);
+#endif
   }
 
   template <typename T, typename RaIt, typename FwdIt>
   inline void  aligned_construct_iter(RaIt lhs, const size_t N, FwdIt rhs)
   {
 #ifdef HRTREE_PARALLEL_ALIGNED_CONSTRUCT
-    const int numt = hrtree_max_num_threads();
-#   pragma omp parallel if(N > 500) for firstprivate(lhs, rhs) schedule(static) num_threads(numt)
-#endif
-    for (int i=0; i<(int)N; ++i)
+    arch::parallel_for(std::ptrdiff_t(0), (std::ptrdiff_t)N, [&](std::ptrdiff_t i)
+    {
       ::new((T*)&(char&)(*(lhs + i))) T(*(rhs + i));
+    }, hrtree_max_num_threads(), N > 500);
+#else
+    for (std::ptrdiff_t i=0; i<(std::ptrdiff_t)N; ++i)
+      ::new((T*)&(char&)(*(lhs + i))) T(*(rhs + i));
+#endif
   }
   
 
@@ -240,11 +266,14 @@ namespace hrtree { namespace memory {
   aligned_destruct(RaIt it, const size_t N)
   {
 #ifdef HRTREE_PARALLEL_ALIGNED_CONSTRUCT
-    const int numt = hrtree_max_num_threads();
-#   pragma omp parallel for if(N>500) firstprivate(it) schedule(static) num_threads(numt)
-#endif
-    for (int i=0; i<(int)N; ++i)
+    arch::parallel_for(std::ptrdiff_t(0), (std::ptrdiff_t)N, [&](std::ptrdiff_t i)
+    {
+      (it + i)->~T();
+    }, hrtree_max_num_threads(), N > 500);
+#else
+    for (std::ptrdiff_t i=0; i<(std::ptrdiff_t)N; ++i)
       (it + i)->~T();
+#endif
   }
 
 }
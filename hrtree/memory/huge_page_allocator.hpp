@@ -0,0 +1,178 @@
+// hrtree/memory/huge_page_allocator.hpp header file
+//
+// Part of the Hilbert Rtree library.
+// Copyright (c) 2000-2014 Hanno Hildenbrandt
+//
+// This software is provided "as is" without express or implied warranty,
+// and with no claim as to its suitability for any purpose.
+//
+// Aligned allocator that backs large blocks with huge pages.
+// Random access into multi-million item node arrays and radix sort
+// buffers touches a new page almost every time; with 4 KB pages that
+// is a TLB miss, with 2 MB pages mostly not.
+
+
+#ifndef HRTREE_MEMORY_HUGE_PAGE_ALLOCATOR_INCLUDED
+#define HRTREE_MEMORY_HUGE_PAGE_ALLOCATOR_INCLUDED
+
+#include <hrtree/config.hpp>
+#include <hrtree/memory/aligned_memory.hpp>
+#include <hrtree/arch/numa.hpp>
+#ifdef _WIN32
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+#endif
+
+
+namespace hrtree { namespace memory {
+
+
+  inline size_t huge_page_round(size_t size)
+  {
+    return (size + HRTREE_HUGE_PAGE_SIZE - 1) & ~(HRTREE_HUGE_PAGE_SIZE - 1);
+  }
+
+
+  // Returns huge page aligned memory of huge_page_round(size) bytes or 0.
+  // Falls back to regular pages if no huge pages are available.
+  inline void* huge_page_malloc(size_t size)
+  {
+    const size_t bytes = huge_page_round(size);
+#ifdef _WIN32
+    const size_t large = GetLargePageMinimum();
+    if (large && 0 == (bytes % large))
+    {
+      void* ptr = VirtualAlloc(0, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+      if (ptr) return ptr;
+    }
+    return VirtualAlloc(0, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+#if defined(HRTREE_HUGE_PAGE_HUGETLB) && defined(MAP_HUGETLB)
+    void* ptr = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (MAP_FAILED != ptr) return ptr;
+#endif
+    // over-allocate and trim to huge page alignment, transparent
+    // huge pages are only used for aligned 2 MB ranges
+    char* raw = (char*)mmap(0, bytes + HRTREE_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == (void*)raw) return 0;
+    char* aligned = (char*)huge_page_round((size_t)raw);
+    if (aligned != raw) munmap(raw, aligned - raw);
+    const size_t tail = (raw + bytes + HRTREE_HUGE_PAGE_SIZE) - (aligned + bytes);
+    if (tail) munmap(aligned + bytes, tail);
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, bytes, MADV_HUGEPAGE);
+#endif
+    return aligned;
+#endif
+  }
+
+
+  // huge_page_malloc with parallel first touch, one touch per huge page
+  inline void* huge_page_malloc_touched(size_t size)
+  {
+    void* ptr = huge_page_malloc(size);
+    if (ptr) arch::parallel_first_touch(ptr, huge_page_round(size), HRTREE_HUGE_PAGE_SIZE);
+    return ptr;
+  }
+
+
+  inline void huge_page_free(void* ptr, size_t size)
+  {
+    if (ptr)
+    {
+#ifdef _WIN32
+      (void)size;
+      VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+      munmap(ptr, huge_page_round(size));
+#endif
+    }
+  }
+
+
+  // Drop-in replacement for aligned_allocator, e.g. as the A parameter
+  // of rtree. Blocks of at least HRTREE_HUGE_PAGE_THRESHOLD bytes are
+  // backed by huge pages and first-touched in parallel, smaller ones
+  // come from aligned_malloc.
+  template <
+    typename T,
+    size_t ALIGN = HRTREE_ALIGNOF(T)
+  >
+  class huge_page_allocator : public aligned_allocator<T, ALIGN>
+  {
+    typedef aligned_allocator<T, ALIGN> base_type;
+
+  public:
+    using base_type::align;
+    using base_type::aligned_size;
+    typedef typename base_type::pointer pointer;
+    typedef typename base_type::size_type size_type;
+    typedef std::true_type allocator_has_page_size;
+
+    huge_page_allocator() {}
+    huge_page_allocator(const huge_page_allocator& x) : base_type(x) {}
+
+    template<typename Other>
+    huge_page_allocator(const huge_page_allocator<Other, align>&) {}
+
+    huge_page_allocator& operator=(const huge_page_allocator&) { return *this; }
+
+    template<class U>
+    struct rebind
+    {
+      typedef huge_page_allocator<U, align> other;
+    };
+
+    static bool is_huge(size_type count)
+    {
+      return count * aligned_size >= HRTREE_HUGE_PAGE_THRESHOLD;
+    }
+
+    static size_t page_size(size_type count)
+    {
+      return is_huge(count) ? HRTREE_HUGE_PAGE_SIZE : 4096;
+    }
+
+    pointer allocate(size_type count)
+    {
+      void* ptr = is_huge(count) ? huge_page_malloc_touched(count * aligned_size) : aligned_malloc<align>(count * aligned_size);
+      if (0 == ptr)
+        throw(std::bad_alloc());
+      return (pointer)ptr;
+    }
+
+    pointer allocate(size_type count, const void*)
+    {
+      return allocate(count);
+    }
+
+    void deallocate(pointer ptr, size_type count)
+    {
+      if (is_huge(count)) huge_page_free((void*)ptr, count * aligned_size);
+      else aligned_free<align>((void*)ptr);
+    }
+
+    template <typename U, size_t B>
+    bool operator==(const huge_page_allocator<U, B>& ) const
+    {
+      return align == B;
+    }
+
+    template <typename U, size_t B>
+    bool operator!=(const huge_page_allocator<U, B>& ) const
+    {
+      return align != B;
+    }
+  };
+
+}
+
+using memory::huge_page_allocator;
+
+}
+
+#endif
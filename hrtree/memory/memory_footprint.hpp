@@ -0,0 +1,85 @@
+// hrtree/memory/memory_footprint.hpp header file
+//
+// Part of the Hilbert Rtree library.
+// Copyright (c) 2000-2014 Hanno Hildenbrandt
+//
+// This software is provided "as is" without express or implied warranty,
+// and with no claim as to its suitability for any purpose.
+
+
+#ifndef HRTREE_MEMORY_MEMORY_FOOTPRINT_INCLUDED
+#define HRTREE_MEMORY_MEMORY_FOOTPRINT_INCLUDED
+
+#include <vector>
+#include <hrtree/config.hpp>
+
+
+namespace hrtree { namespace memory {
+
+
+  // Heap memory held by an object, in bytes.
+  struct memory_footprint
+  {
+    size_t levels = 0;          // used tree nodes, all levels
+    size_t permutation = 0;     // leaf -> item mapping
+    size_t sort_scratch = 0;    // buffers only needed during the build
+    size_t slack = 0;           // allocated but unused capacity
+    size_t other = 0;           // everything else, e.g. agents and grids
+
+    size_t total() const { return levels + permutation + sort_scratch + slack + other; }
+
+    memory_footprint& operator+=(const memory_footprint& rhs)
+    {
+      levels += rhs.levels;
+      permutation += rhs.permutation;
+      sort_scratch += rhs.sort_scratch;
+      slack += rhs.slack;
+      other += rhs.other;
+      return *this;
+    }
+
+    friend memory_footprint operator+(memory_footprint lhs, const memory_footprint& rhs)
+    {
+      return lhs += rhs;
+    }
+  };
+
+
+  // Footprint of a std::vector-like container, counted as 'other'.
+  template <typename C>
+  inline memory_footprint container_footprint(const C& c)
+  {
+    memory_footprint mf;
+    mf.other = c.size() * sizeof(typename C::value_type);
+    mf.slack = (c.capacity() - c.size()) * sizeof(typename C::value_type);
+    return mf;
+  }
+
+
+  // Keeps the largest footprint seen across a run.
+  class peak_memory
+  {
+  public:
+    peak_memory() {}
+
+    void sample(const memory_footprint& mf)
+    {
+      if (mf.total() > peak_.total()) peak_ = mf;
+    }
+
+    void reset() { peak_ = memory_footprint(); }
+    size_t peak() const { return peak_.total(); }
+    const memory_footprint& at_peak() const { return peak_; }
+
+  private:
+    memory_footprint peak_;
+  };
+
+}
+
+using memory::memory_footprint;
+using memory::peak_memory;
+
+}
+
+#endif
@@ -0,0 +1,86 @@
+// hrtree/memory/numa_replica.hpp header file
+//
+// Part of the Hilbert Rtree library.
+// Copyright (c) 2000-2014 Hanno Hildenbrandt
+//
+// This software is provided "as is" without express or implied warranty,
+// and with no claim as to its suitability for any purpose.
+
+
+#ifndef HRTREE_MEMORY_NUMA_REPLICA_INCLUDED
+#define HRTREE_MEMORY_NUMA_REPLICA_INCLUDED
+
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <hrtree/config.hpp>
+#include <hrtree/arch/numa.hpp>
+
+
+namespace hrtree { namespace memory {
+
+
+  // Per NUMA node copies of a read-only object, e.g. a built tree.
+  // Each copy is made by a thread running on its node, so its pages are
+  // local to that node. Query threads should be pinned (see pin_threads)
+  // and pick their copy with local().
+  //
+  // numa_replica<torus::hrtree_t> rep;
+  // tree.build(...);
+  // rep.replicate(tree);
+  // parallel_for(0, n, [&](int i) { rep.local(tree).query(...); });
+  template <typename T>
+  class numa_replica
+  {
+  public:
+    numa_replica() {}
+
+    // Copies master to every node with at least one OpenMP thread.
+    // Nodes without replica fall back to master.
+    void replicate(const T& master)
+    {
+      const int nodes = arch::numa_num_nodes();
+      replica_.clear();
+      replica_.resize(nodes);
+      if (nodes < 2) return;
+      std::vector<std::atomic<int>> claimed(nodes);
+      for (auto& c : claimed) c = 0;
+      arch::parallel_region([&](arch::team&)
+      {
+        const int node = arch::numa_current_node();
+        if (0 == claimed[node].exchange(1))
+        {
+          replica_[node].reset(new T(master));
+        }
+      });
+    }
+
+    // Drops the copies.
+    void clear() { replica_.clear(); }
+
+    // The copy on the node of the calling thread, master if there is none.
+    const T& local(const T& master) const
+    {
+      if (replica_.empty()) return master;
+      const T* r = replica_[arch::numa_current_node()].get();
+      return r ? *r : master;
+    }
+
+    size_t size() const
+    {
+      size_t n = 0;
+      for (auto& r : replica_) n += (r != nullptr);
+      return n;
+    }
+
+  private:
+    std::vector<std::unique_ptr<T>> replica_;
+  };
+
+}
+
+using memory::numa_replica;
+
+}
+
+#endif
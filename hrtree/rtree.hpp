@@ -11,6 +11,7 @@
 
 #include <hrtree/rtree_base.hpp>
 #include <hrtree/mbr_build_policy.hpp>
+#include <hrtree/visitor.hpp>
 
 
 namespace hrtree {
@@ -19,12 +20,14 @@ namespace hrtree {
   template <
     typename BV,
     typename BP = mbr_build_policy<BV>,
-    size_t FANOUT = 8,
-    typename A = aligned_allocator< BV, HRTREE_ALIGNOF(BV) >
+    size_t NODE_FANOUT = 8,
+    typename A = aligned_allocator< BV, HRTREE_ALIGNOF(BV) >,
+    template <size_t, size_t> class L = level_layout,
+    size_t LEAF_FANOUT = NODE_FANOUT
   >
-  class rtree : public rtree_base<BV, BP, FANOUT, A>
+  class rtree : public rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>
   {
-    typedef rtree_base<BV,BP,FANOUT,A> base_type;
+    typedef rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT> base_type;
     using base_type::stack_element;
   
   public:
@@ -34,6 +37,7 @@ namespace hrtree {
     using base_type::bv_iterator;
     using base_type::const_bv_iterator;
     using base_type::build_policy;
+    using base_type::layout_type;
   
   public:
     rtree()  {}
@@ -54,13 +58,13 @@ namespace hrtree {
     template <typename FwdIt>
     void build(FwdIt first, FwdIt last)
     {
-      build(first, last, base_type::identity_conversion());
+      build(first, last, typename base_type::identity_conversion());
     }
 
     template <typename FwdIt>
     void parallel_build(FwdIt first, FwdIt last)
     {
-      parallel_build(first, last, base_type::identity_conversion());
+      parallel_build(first, last, typename base_type::identity_conversion());
     }
 
     template <typename FwdIt, typename Conversion>
@@ -72,58 +76,44 @@ namespace hrtree {
     template <typename FwdIt, typename Constructor>
     void parallel_construct(FwdIt first, FwdIt last, Constructor ctor);
 
+    // query_fun may return bool, false stops the query.
+    // Returns false if the query was stopped.
     template <typename FwdIt, typename CullPolicy, typename QueryFun>
-    void query(FwdIt cfirst, const CullPolicy& cull_policy, QueryFun& query_fun) const;
+    bool query(FwdIt cfirst, const CullPolicy& cull_policy, QueryFun& query_fun) const;
 
     template <typename CullPolicy, typename QueryFun>
-    void query(const CullPolicy& cull_policy, QueryFun& query_fun) const;
+    bool query(const CullPolicy& cull_policy, QueryFun& query_fun) const;
   };
 
 
-  template <typename BV, typename BP, size_t FANOUT, typename A>
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
   template <typename FwdIt, typename Conversion>
-  void rtree<BV,BP,FANOUT,A>::parallel_build(FwdIt first, FwdIt last, Conversion conv)
+  void rtree<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::parallel_build(FwdIt first, FwdIt last, Conversion conv)
   {
-    std::mutex emutex;
-    std::exception_ptr eptr;
-
     base_type::build_index(std::distance(first, last));
 
     // Construct leaf bounding volumes
-    const int N = static_cast<int>(this->leaf_nodes());
-#   pragma omp parallel firstprivate(first, conv)
+    const std::ptrdiff_t N = static_cast<std::ptrdiff_t>(this->leaf_nodes());
+    arch::parallel_for(std::ptrdiff_t(0), N, [&](std::ptrdiff_t i)
     {
-      try
-      {
-#       pragma omp for schedule(static)
-        for (int i=0; i<N; ++i)
-        {
-          FwdIt src(first);
-          std::advance(src, i);
-          this->alloc_.construct(&*(this->index_[0] + i), conv(*src));
-        }
-      }
-      catch (...)
-      {
-        std::lock_guard<std::mutex> lock(emutex);
-        eptr = std::current_exception();
-      }
-    }
-    if (eptr != nullptr) std::rethrow_exception(eptr);
+      FwdIt src(first);
+      std::advance(src, i);
+      this->alloc_.construct(&*(this->index_[0] + i), conv(*src));
+    });
     base_type::parallel_build_hierarchy();
   }
 
 
-  template <typename BV, typename BP, size_t FANOUT, typename A>
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
   template <typename FwdIt, typename Conversion>
-  void rtree<BV,BP,FANOUT,A>::build(FwdIt first, FwdIt last, Conversion conv)
+  void rtree<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::build(FwdIt first, FwdIt last, Conversion conv)
   {
     base_type::build_index(std::distance(first, last));
 
     // Construct leaf bounding volumes
-    const int N = (int)this->leaf_nodes();
+    const std::ptrdiff_t N = (std::ptrdiff_t)this->leaf_nodes();
     typename base_type::bv_iterator dst(this->index_[0]);
-    for (int i=0; i<N; ++i)
+    for (std::ptrdiff_t i=0; i<N; ++i)
     {
       this->alloc_.construct(&*dst, conv(*first));
       ++dst;
@@ -133,16 +123,16 @@ namespace hrtree {
   }
 
 
-  template <typename BV, typename BP, size_t FANOUT, typename A>
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
   template <typename FwdIt, typename Constructor>
-  void rtree<BV,BP,FANOUT,A>::construct(FwdIt first, FwdIt last, Constructor ctor)
+  void rtree<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::construct(FwdIt first, FwdIt last, Constructor ctor)
   {
-    typename base_type::build_index(std::distance(first, last));
+    base_type::build_index(std::distance(first, last));
 
     // Construct leaf bounding volumes
-    const int N = (int)this->leaf_nodes();
+    const std::ptrdiff_t N = (std::ptrdiff_t)this->leaf_nodes();
     typename base_type::bv_iterator dst(this->index_[0]);
-    for (int i=0; i<N; ++i)
+    for (std::ptrdiff_t i=0; i<N; ++i)
     {
       ctor(&*dst, *first);
       ++dst;
@@ -152,83 +142,71 @@ namespace hrtree {
   }
 
 
-  template <typename BV, typename BP, size_t FANOUT, typename A>
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
   template <typename FwdIt, typename Constructor>
-  void rtree<BV,BP,FANOUT,A>::parallel_construct(FwdIt first, FwdIt last, Constructor ctor)
+  void rtree<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::parallel_construct(FwdIt first, FwdIt last, Constructor ctor)
   {
-    std::mutex emutex;
-    std::exception_ptr eptr;
-
     base_type::build_index(std::distance(first, last));
 
     // Construct leaf bounding volumes
-    const int N = (int)this->leaf_nodes();
-#   pragma omp parallel firstprivate(first, ctor)
+    const std::ptrdiff_t N = (std::ptrdiff_t)this->leaf_nodes();
+    arch::parallel_for(std::ptrdiff_t(0), N, [&](std::ptrdiff_t i)
     {
-      try
-      {
-#       pragma omp for schedule(static)
-        for (int i=0; i<N; ++i)
-        {
-          FwdIt src(first);
-          std::advance(src, i);
-          ctor(&*(this->index_[0] + i), *src);
-        }
-      }
-      catch (...)
-      {
-        std::lock_guard<std::mutex> lock(emutex);
-        eptr = std::current_exception();
-      }
-    }
-    if (eptr != nullptr) std::rethrow_exception(eptr);
+      FwdIt src(first);
+      std::advance(src, i);
+      ctor(&*(this->index_[0] + i), *src);
+    });
     base_type::parallel_build_hierarchy();
   }
 
 
-  template <typename BV, typename BP, size_t FANOUT, typename A>
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
   template <typename FwdIt, typename CullPolicy, typename QueryFun>
-  void rtree<BV,BP,FANOUT,A>::query(
+  bool rtree<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::query(
     FwdIt cfirst,
     const CullPolicy& cull_policy,
     QueryFun& query_fun
     ) const
   {
-    if (this->empty()) return;
+    if (this->empty()) return true;
     size_t level = base_type::height_ - 1;
     typename base_type::stack_element stack[base_type::MaxHeight];
-    stack[level] = base_type::stack_element(0,1);
+    stack[level] = typename base_type::stack_element(0,1);
     while (level < base_type::height_)
     {
       typename base_type::stack_element& s = stack[level];
-      typename base_type::const_bv_iterator first( this->index_[level] + s.first );
+      typename base_type::const_bv_iterator first( this->node(level, s.first) );
       s.second = std::min(s.second, this->level_nodes(level));
-      for (; s.first < s.second; ++s.first)
+      for (; s.first < s.second; this->advance(first, level, ++s.first))
       {
-        if (cull_policy(*first++))
+        if (cull_policy(*first))
         {
-          size_t next_level_first = s.first * FANOUT;
-          for (++s.first; s.first < s.second; ++s.first)
+          // fetch the children while the remaining siblings are tested
+          this->prefetch_children(level, s.first);
+          const size_t F = base_type::child_fanout(level);
+          size_t next_level_first = s.first * F;
+          for (this->advance(first, level, ++s.first); s.first < s.second; this->advance(first, level, ++s.first))
           {
-            if (!cull_policy(*first++))
+            if (!cull_policy(*first))
             {
               break;
             }
+            this->prefetch_children(level, s.first);
           }
           if (level > 1)
           {
-            stack[--level] = base_type::stack_element(next_level_first, s.first * FANOUT);
+            stack[--level] = typename base_type::stack_element(next_level_first, s.first * F);
             goto descent;
           }
           FwdIt it(cfirst);
           std::advance(it, next_level_first);
           typename base_type::const_bv_iterator first_leaf(this->index_[0] + next_level_first);
-          typename base_type::const_bv_iterator last_leaf = std::min(this->index_[0] + s.first * FANOUT, this->index_[1]);
+          typename base_type::const_bv_iterator last_leaf(this->index_[0] + std::min(s.first * F, this->leaf_nodes()));
           for (; first_leaf != last_leaf; ++first_leaf, ++it)
           {
-            if (cull_policy(*first_leaf))
+            if (cull_policy(*first_leaf) && !invoke_visitor(query_fun, *it))
             {
-              query_fun(*it);
+              return false;
             }
           }
         }
@@ -237,50 +215,55 @@ namespace hrtree {
 descent:
       ;
     }
+    return true;
   }
 
 
-  template <typename BV, typename BP, size_t FANOUT, typename A>
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
   template <typename CullPolicy, typename QueryFun>
-  void rtree<BV, BP, FANOUT, A>::query(
+  bool rtree<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::query(
     const CullPolicy& cull_policy,
     QueryFun& query_fun
     ) const
   {
-    if (this->empty()) return;
+    if (this->empty()) return true;
     size_t level = base_type::height_ - 1;
     typename base_type::stack_element stack[base_type::MaxHeight];
     stack[level] = typename base_type::stack_element(0, 1);
     while (level < base_type::height_)
     {
       typename base_type::stack_element& s = stack[level];
-      typename base_type::const_bv_iterator first(this->index_[level] + s.first);
+      typename base_type::const_bv_iterator first(this->node(level, s.first));
       s.second = std::min(s.second, this->level_nodes(level));
-      for (; s.first < s.second; ++s.first)
+      for (; s.first < s.second; this->advance(first, level, ++s.first))
       {
-        if (cull_policy(*first++))
+        if (cull_policy(*first))
         {
-          size_t next_level_first = s.first * FANOUT;
-          for (++s.first; s.first < s.second; ++s.first)
+          // fetch the children while the remaining siblings are tested
+          this->prefetch_children(level, s.first);
+          const size_t F = base_type::child_fanout(level);
+          size_t next_level_first = s.first * F;
+          for (this->advance(first, level, ++s.first); s.first < s.second; this->advance(first, level, ++s.first))
           {
-            if (!cull_policy(*first++))
+            if (!cull_policy(*first))
             {
               break;
             }
+            this->prefetch_children(level, s.first);
           }
           if (level > 1)
           {
-            stack[--level] = typename base_type::stack_element(next_level_first, s.first * FANOUT);
+            stack[--level] = typename base_type::stack_element(next_level_first, s.first * F);
             goto descent;
           }
           size_t leaf_idx = next_level_first;
           typename base_type::const_bv_iterator first_leaf(this->index_[0] + next_level_first);
-          typename base_type::const_bv_iterator last_leaf = std::min(this->index_[0] + s.first * FANOUT, this->index_[1]);
+          typename base_type::const_bv_iterator last_leaf(this->index_[0] + std::min(s.first * F, this->leaf_nodes()));
           for (; first_leaf != last_leaf; ++first_leaf, ++leaf_idx)
           {
-            if (cull_policy(*first_leaf))
+            if (cull_policy(*first_leaf) && !invoke_visitor(query_fun, leaf_idx))
             {
-              query_fun(leaf_idx);
+              return false;
             }
           }
         }
@@ -289,6 +272,7 @@ descent:
     descent:
       ;
     }
+    return true;
   }
 
 
@@ -10,8 +10,6 @@
 #ifndef HRTREE_RTREE_BASE_HPP
 #define HRTREE_RTREE_BASE_HPP
 
-#include <exception>
-#include <mutex>
 #include <cassert>
 #include <iterator>
 #include <utility>
@@ -19,15 +17,23 @@
 #include <hrtree/config.hpp>
 #include <hrtree/memory/aligned_memory.hpp>
 #include <hrtree/memory/aligned_iterator.hpp>
+#include <hrtree/memory/memory_footprint.hpp>
+#include <hrtree/layout_policy.hpp>
+#include <hrtree/arch/prefetch.hpp>
+#include <hrtree/arch/parallel.hpp>
+#include <hrtree/arch/numa.hpp>
 
 
 namespace hrtree { 
 
 
+  // NODE_FANOUT children per inner node, LEAF_FANOUT leaves per level 1 node.
   template <typename BV,
         typename BP,
-        size_t FANOUT,
-        typename A
+        size_t NODE_FANOUT,
+        typename A,
+        template <size_t, size_t> class L = level_layout,
+        size_t LEAF_FANOUT = NODE_FANOUT
   >
   class rtree_base
   {
@@ -46,9 +52,10 @@ namespace hrtree {
     typedef const_aligned_iter                const_bv_iterator;
     typedef BP                                build_policy;
     typedef A                                 allocator_type;
+    typedef L<NODE_FANOUT, MaxHeight>         layout_type;
 
   protected:
-    rtree_base() : index_(), height_(0), capacity_(0) {}
+    rtree_base() : index_(), height_(0), capacity_(0), layout_(), prefetch_lines_(HRTREE_PREFETCH_LINES) {}
     rtree_base(const rtree_base& x);
     rtree_base& operator=(const rtree_base& rhs);
     virtual ~rtree_base();
@@ -62,23 +69,51 @@ namespace hrtree {
   public:
     bool empty() const { return 0 == height_; }
     size_t max_nodes() const { return alloc_.max_size(); }
-    size_t nodes() const { return (height_) ? index_[height_-1] - index_[0] : 0; }
-    size_t buckets() const { return nodes() / FANOUT; }
-    size_t leaf_nodes() const { return index_[1] - index_[0]; }
-    size_t level_nodes(size_t i) const { assert( i < height_); return index_[i + 1] - index_[i]; }
+    size_t nodes() const 
+    { 
+      size_t n = 0;
+      for (size_t level = 0; level < height_; ++level) n += layout_.level_nodes(level);
+      return n;
+    }
+    size_t buckets() const { return (layout_.level_nodes(0) + LEAF_FANOUT - 1) / LEAF_FANOUT; }
+    size_t leaf_nodes() const { return layout_.level_nodes(0); }
+    size_t level_nodes(size_t i) const { assert( i < height_); return layout_.level_nodes(i); }
     size_t max_height() const { return size_t(MaxHeight); }
     size_t height() const { return height_; }
-    size_t fanout() const { return size_t(FANOUT); }
+    size_t fanout() const { return size_t(NODE_FANOUT); }
+    size_t leaf_fanout() const { return size_t(LEAF_FANOUT); }
+
+    // Cache lines of a child block prefetched during traversal, 0: none.
+    size_t prefetch_lines() const { return prefetch_lines_; }
+    void prefetch_lines(size_t lines) { prefetch_lines_ = lines; }
+
+    // Number of children of a node of the given level.
+    static size_t child_fanout(size_t level) { return (1 == level) ? LEAF_FANOUT : NODE_FANOUT; }
+
+    // Node array: used slots in levels, remaining capacity in slack.
+    memory_footprint memory_usage() const
+    {
+      const size_t used = (height_) ? size_t(index_[height_] - index_[0]) : 0;
+      memory_footprint mf;
+      mf.levels = used * aligned_iter::aligned_size;
+      mf.slack = (capacity_ - used) * aligned_iter::aligned_size;
+      return mf;
+    }
 
     const bv_reference total_bv() const { assert( 0 != height_ ); return *index_[height_ - 1]; }
     const bv_reference leaf_bv(size_t i) const { assert( i < leaf_nodes()); return *(index_[0] + i); }
     bv_reference leaf_bv(size_t i) { assert( i < leaf_nodes()); return *(index_[0] + i); }
 
-    const_bv_iterator level_begin(size_t level) const { return index_[level]; }
-    const_bv_iterator level_end(size_t level) const { return index_[level + 1]; }
+    // Node i of the given level. Siblings are contiguous in any layout.
+    const_bv_iterator node(size_t level, size_t i) const { return index_[0] + layout_.slot(level, i); }
+    bv_iterator node(size_t level, size_t i) { return index_[0] + layout_.slot(level, i); }
 
-    bv_iterator level_begin(size_t level) { return index_[level]; }
-    bv_iterator level_end(size_t level) { return index_[level + 1]; }
+    // Level iterators, contiguous layouts only.
+    const_bv_iterator level_begin(size_t level) const { static_assert(layout_type::contiguous, "rtree_base: level_begin requires a contiguous layout"); return node(level, 0); }
+    const_bv_iterator level_end(size_t level) const { static_assert(layout_type::contiguous, "rtree_base: level_end requires a contiguous layout"); return node(level, 0) + level_nodes(level); }
+
+    bv_iterator level_begin(size_t level) { static_assert(layout_type::contiguous, "rtree_base: level_begin requires a contiguous layout"); return node(level, 0); }
+    bv_iterator level_end(size_t level) { static_assert(layout_type::contiguous, "rtree_base: level_end requires a contiguous layout"); return node(level, 0) + level_nodes(level); }
 
     void build_index(size_t n);
     void build_hierarchy();
@@ -87,6 +122,40 @@ namespace hrtree {
   protected:
     typedef std::pair< size_t, size_t > stack_element;
 
+    // Prefetches the child block of node i of the given level.
+    void prefetch_children(size_t level, size_t i) const
+    {
+      prefetch(&*node(level - 1, i * child_fanout(level)), prefetch_lines_);
+    }
+
+    // Advances it from node i-1 to node i of the given level.
+    void advance(const_bv_iterator& it, size_t level, size_t i) const
+    {
+      if (layout_type::contiguous || (i % NODE_FANOUT)) ++it;
+      else it = node(level, i);
+    }
+
+    // The number of nodes of the given level below a node k levels above.
+    static size_t subtree_span(size_t level, size_t k)
+    {
+      size_t span = 1;
+      while (k--) span *= child_fanout(++level);
+      return span;
+    }
+
+    // Highest level whose subtrees fit into half of the L2 cache.
+    size_t cache_level() const
+    {
+      size_t level = 0;
+      while (level + 1 < height_ && subtree_span(0, level + 1) * sizeof(bv_type) <= HRTREE_L2_CACHE_SIZE / 2) ++level;
+      return level;
+    }
+
+    void destruct_nodes();
+    void first_touch(size_t page);
+    void build_levels(size_t lo, size_t hi, size_t first, size_t last, build_policy& buildPolicy);
+    void build_subtrees(size_t top, size_t first, size_t last, build_policy& buildPolicy);
+
     struct identity_conversion
     {
       template <typename T>
@@ -96,26 +165,30 @@ namespace hrtree {
     bv_iterator  index_[MaxHeight + 1];
     size_t    height_, capacity_;
     allocator_type  alloc_;
+    layout_type  layout_;
+    size_t    prefetch_lines_;
   };
 
 
-  template <typename BV, typename BP, size_t FANOUT, typename A>
-  rtree_base<BV,BP,FANOUT,A>::rtree_base(const rtree_base& x)
-    : index_(), height_(0), capacity_(0) 
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
+  rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::rtree_base(const rtree_base& x)
+    : index_(), height_(0), capacity_(0), layout_(), prefetch_lines_(x.prefetch_lines_) 
   {
+    if (x.empty()) return;
     build_index(x.leaf_nodes());
-    bv_iterator dst = index_[0];
-    const_bv_iterator src = x.index_[0];
-    const int N = (int)nodes();
-    for (int i=0; i <= N; ++i)
+    for (size_t level = 0; level < height_; ++level)
     {
-      alloc_.construct(&*(dst + i), *(src + i));
+      const size_t n = level_nodes(level);
+      for (size_t i = 0; i < n; ++i)
+      {
+        alloc_.construct(&*node(level, i), *x.node(level, i));
+      }
     }
   }
 
 
-  template <typename BV, typename BP, size_t FANOUT, typename A>
-  rtree_base<BV, BP, FANOUT, A>& rtree_base<BV, BP, FANOUT, A>::operator=(const rtree_base<BV, BP, FANOUT, A>& rhs)
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
+  rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>& rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::operator=(const rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>& rhs)
   {
     rtree_base tmp(rhs);
     swap(tmp);
@@ -123,19 +196,19 @@ namespace hrtree {
   }
 
 
-  template <typename BV, typename BP, size_t FANOUT, typename A>
-  rtree_base<BV,BP,FANOUT,A>::~rtree_base()
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
+  rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::~rtree_base()
   { 
     if (0 != capacity_)
     {
-      memory::aligned_destruct<BV>(index_[0], nodes());  // orphan remaining nodes
+      destruct_nodes();  // orphan remaining nodes
       alloc_.deallocate(&*index_[0], capacity_);
     }
   }
 
 
-  template <typename BV, typename BP, size_t FANOUT, typename A>
-  void rtree_base<BV,BP,FANOUT,A>::swap(rtree_base<BV, BP,FANOUT,A>& other)
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
+  void rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::swap(rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>& other)
   {
     if (this != &other)
     {
@@ -145,20 +218,22 @@ namespace hrtree {
       }
       std::swap(height_, other.height_);
       std::swap(capacity_, other.capacity_);
+      std::swap(layout_, other.layout_);
+      std::swap(prefetch_lines_, other.prefetch_lines_);
     }
   }
 
 
-  template <typename BV, typename BP, size_t FANOUT, typename A>
-  rtree_base<BV,BP,FANOUT,A>::rtree_base(rtree_base&& rhs)
-    : index_(), height_(0), capacity_(0) 
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
+  rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::rtree_base(rtree_base&& rhs)
+    : index_(), height_(0), capacity_(0), layout_(), prefetch_lines_(HRTREE_PREFETCH_LINES) 
   {
     swap(std::forward<rtree_base>(rhs));
   }
 
 
-  template <typename BV, typename BP, size_t FANOUT, typename A>
-  rtree_base<BV, BP, FANOUT, A>& rtree_base<BV, BP, FANOUT, A>::operator=(rtree_base<BV, BP, FANOUT, A>&& rhs)
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
+  rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>& rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::operator=(rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>&& rhs)
   {
     if (this != &rhs)
     {
@@ -169,8 +244,8 @@ namespace hrtree {
   }
 
 
-  template <typename BV, typename BP, size_t FANOUT, typename A>
-  void rtree_base<BV,BP,FANOUT,A>::swap(rtree_base<BV, BP,FANOUT,A>&& other)
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
+  void rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::swap(rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>&& other)
   {
     if (this != &other)
     {
@@ -180,115 +255,180 @@ namespace hrtree {
       }
       height_ = other.height_; other.height_ = 0;
       capacity_ = other.capacity_; other.capacity_ = 0;
+      layout_ = other.layout_; other.layout_ = layout_type();
+      prefetch_lines_ = other.prefetch_lines_;
     }
   }
 
 
-  template <typename BV, typename BP, size_t FANOUT, typename A>
-  void rtree_base<BV,BP,FANOUT,A>::clear()
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
+  void rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::clear()
   {
     rtree_base tmp;
+    tmp.prefetch_lines_ = prefetch_lines_;
     swap(tmp);
   }
   
   
-  template <typename BV, typename BP, size_t FANOUT, typename A>
-  void rtree_base<BV,BP,FANOUT,A>::build_index(size_t n)
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
+  void rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::build_index(size_t n)
   {
-    memory::aligned_destruct<BV>(index_[0], nodes());
+    destruct_nodes();
     if (0 == n)
     {
       height_ = 0;
+      layout_ = layout_type();
       index_[1] = index_[0];
       return;
     }
     if (n != leaf_nodes()) 
     {
-      size_t offs[MaxHeight+1] = {};
-      size_t N = 0;
-      size_t level = 1;
+      bool fresh = false;
+      size_t count[MaxHeight] = {};
+      size_t level = 0;
       do
       {
-        offs[level++] = (N += n);
-        n = (n-1+FANOUT)/FANOUT;
+        count[level++] = n;
+        n = (level == 1) ? (n-1+LEAF_FANOUT)/LEAF_FANOUT : (n-1+NODE_FANOUT)/NODE_FANOUT;
       } while (n > 1);
-      offs[level] = ++N;
+      count[level++] = 1;
+      const size_t N = layout_.init(count, level);
       if (N > capacity_)
       {
-        alloc_.deallocate(&*index_[0], capacity_);
+        if (capacity_) alloc_.deallocate(&*index_[0], capacity_);
         height_ = capacity_ = 0;
         index_[0] = bv_iterator(alloc_.allocate(N));
         capacity_ = N;
+        fresh = true;
       }
 
       // Initialize the index array.
-      // [index_[i], index_[i+1]) <- [begin, end) - range of bounding volumes in level i.
+      // index_[i] <- first node of level i, index_[height_] <- end of the node array.
       //
       height_ = level;
-      for (level = 1; level <= height_; ++level)
+      for (level = 1; level < height_; ++level)
       {
-        index_[level] = index_[0] + offs[level];
+        index_[level] = node(level, 0);
       }
+      index_[height_] = index_[0] + N;
+      if (fresh) first_touch(memory::allocator_page_size<A>::get(N));
     }
   }
 
 
-  template <typename BV, typename BP, size_t FANOUT, typename A>
-  void rtree_base<BV,BP,FANOUT,A>::parallel_build_hierarchy()
+  // NUMA: every level is first-touched with the static schedule of
+  // parallel_first_touch, thread i touches the pages of the i-th block
+  // of the level. These are the nodes it constructs in the parallel
+  // build and, with queries sorted like the items, the nodes its
+  // queries visit most. Non-contiguous layouts are touched as a whole.
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
+  void rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::first_touch(size_t page)
   {
-    std::mutex emutex;
-    std::exception_ptr eptr;
+    if (!layout_type::contiguous)
+    {
+      const bv_pointer first = index_[0].operator->();
+      arch::parallel_first_touch(first, (char*)index_[height_].operator->() - (char*)first, page);
+      return;
+    }
+    for (size_t level = 0; level < height_; ++level)
+    {
+      const bv_pointer first = node(level, 0).operator->();
+      arch::parallel_first_touch(first, (char*)(node(level, 0) + level_nodes(level)).operator->() - (char*)first, page);
+    }
+  }
 
-    for (size_t level = 1; level < height_; ++level)
+
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
+  void rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::destruct_nodes()
+  {
+    for (size_t level = 0; level < height_; ++level)
     {
-      bv_iterator dst = index_[level];
-      const_bv_iterator first = index_[level-1];
-      const_bv_iterator last = dst;
-      const int N = (int)level_nodes(level);
-#     pragma omp parallel firstprivate(dst)
+      if (layout_type::contiguous)
       {
-        try
-        {
-          build_policy buildPolicy;
-#         pragma omp for schedule(static) nowait
-          for (int i = 0; i < N; ++i)
-          {
-            const_bv_iterator src = first + i * FANOUT;
-            alloc_.construct(&*(dst + i), *src);
-            buildPolicy(src + 1, std::min(src + FANOUT, last), dst + i);
-          }
-        }
-        catch (...)
+        memory::aligned_destruct<BV>(node(level, 0), level_nodes(level));
+      }
+      else
+      {
+        for (size_t i = 0; i < level_nodes(level); ++i)
         {
-          std::lock_guard<std::mutex> lock(emutex);
-          eptr = std::current_exception();
+          memory::aligned_destruct<BV>(node(level, i), 1);
         }
       }
-      if (eptr != nullptr) std::rethrow_exception(eptr);
     }
   }
 
 
-  template <typename BV, typename BP, size_t FANOUT, typename A>
-  void rtree_base<BV,BP,FANOUT,A>::build_hierarchy()
+  // Builds the levels [lo, hi] below the nodes [first, last) of level hi.
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
+  void rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::build_levels(size_t lo, size_t hi, size_t first, size_t last, build_policy& buildPolicy)
   {
-    build_policy buildPolicy;
-    for (size_t level = 1; level < height_; ++level)
+    for (size_t level = lo; level <= hi; ++level)
     {
-      bv_iterator dst = index_[level];
-      const_bv_iterator first = index_[level-1];
-      const_bv_iterator last = dst;
-      const size_t n = level_nodes(level);
-      for (size_t i = 0; i < n; ++i)
+      const size_t span = subtree_span(level, hi - level);
+      const size_t n = std::min(last * span, level_nodes(level));
+      const size_t m = level_nodes(level-1);
+      const size_t F = child_fanout(level);
+      for (size_t i = first * span; i < n; ++i)
       {
-        const_bv_iterator src = first + i * FANOUT;
-        alloc_.construct(&*(dst + i), *src);
-        buildPolicy(src + 1, std::min(src + FANOUT, last), dst + i);
+        const_bv_iterator src = node(level-1, i * F);
+        bv_iterator dst = node(level, i);
+        alloc_.construct(&*dst, *src);
+        buildPolicy(src + 1, src + std::min(F, m - i * F), dst);
       }
     }
   }
 
 
+  // Builds the levels [1, top] below the nodes [first, last) of level top.
+  // The subtrees that fit into the L2 cache are completed one after the
+  // other, the levels above them are built afterwards.
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
+  void rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::build_subtrees(size_t top, size_t first, size_t last, build_policy& buildPolicy)
+  {
+    const size_t cl = std::min(cache_level(), top);
+    const size_t span = subtree_span(cl, top - cl);
+    const size_t c1 = std::min(last * span, level_nodes(cl));
+    for (size_t c = first * span; c < c1; ++c)
+    {
+      build_levels(1, cl, c, c + 1, buildPolicy);
+    }
+    build_levels(cl + 1, top, first, last, buildPolicy);
+  }
+
+
+  // The subtrees below the split level are distributed over the threads in
+  // contiguous ranges, the few levels above are built serially.
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
+  void rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::parallel_build_hierarchy()
+  {
+    const int numt = hrtree_max_num_threads();
+    size_t split = (height_) ? height_ - 1 : 0;
+    while (split && level_nodes(split) < size_t(8 * numt)) --split;
+    if (numt < 2 || 0 == split)
+    {
+      build_hierarchy();
+      return;
+    }
+    arch::parallel_region(numt, true, [&](arch::team& t)
+    {
+      const auto block = t.static_block(size_t(0), level_nodes(split));
+      build_policy buildPolicy;
+      build_subtrees(split, block.first, block.second, buildPolicy);
+    });
+    build_policy buildPolicy;
+    build_levels(split + 1, height_ - 1, 0, 1, buildPolicy);
+  }
+
+
+  template <typename BV, typename BP, size_t NODE_FANOUT, typename A, template <size_t, size_t> class L, size_t LEAF_FANOUT>
+  void rtree_base<BV, BP, NODE_FANOUT, A, L, LEAF_FANOUT>::build_hierarchy()
+  {
+    if (height_ < 2) return;
+    build_policy buildPolicy;
+    build_subtrees(height_ - 1, 0, 1, buildPolicy);
+  }
+
+
 }
 
 
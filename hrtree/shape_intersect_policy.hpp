@@ -0,0 +1,304 @@
+// hrtree/shape_intersect_policy.hpp header file
+//
+// Part of the Hilbert Rtree library.
+// Copyright (c) 2000-2014 Hanno Hildenbrandt
+//
+// This software is provided "as is" without express or implied warranty,
+// and with no claim as to its suitability for any purpose.
+//
+// Cull policies for non axis-aligned 2D query regions: convex polygon,
+// oriented box, disc and annulus. The convex shapes are tested by
+// separating axes, several axes at once if simd is available.
+
+#ifndef HRTREE_SHAPE_INTERSECT_POLICY_HPP_INCLUDED
+#define HRTREE_SHAPE_INTERSECT_POLICY_HPP_INCLUDED
+
+#include <cmath>
+#include <cassert>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <hrtree/adapt_mbr.hpp>
+#include <hrtree/arch/select.hpp>
+
+
+namespace hrtree {
+
+  namespace detail {
+
+    // Separating axes of a convex 2D shape, relative to its reference
+    // point ref. Structure of arrays, padded to a multiple of 4 axes.
+    template <typename T>
+    struct convex_shape
+    {
+      T ref[2];
+      T x0, x1, y0, y1;       // bounding box
+      std::vector<T> nx, ny;  // axes
+      std::vector<T> ax, ay;  // |axes|
+      std::vector<T> lo, hi;  // extent of the shape along the axes
+
+      void add_axis(T x, T y, T l, T h)
+      {
+        nx.push_back(x); ny.push_back(y);
+        ax.push_back(std::abs(x)); ay.push_back(std::abs(y));
+        lo.push_back(l); hi.push_back(h);
+      }
+
+      // repeats the first axis up to the next multiple of 4
+      void pad()
+      {
+        assert(!nx.empty());
+        while (nx.size() % 4) add_axis(nx[0], ny[0], lo[0], hi[0]);
+      }
+
+      // the box with center ref + (dx, dy) and radii (rx, ry)
+      // overlaps the bounding box
+      bool bounds(T dx, T dy, T rx, T ry) const
+      {
+        return (dx - rx <= x1) && (dx + rx >= x0) && (dy - ry <= y1) && (dy + ry >= y0);
+      }
+
+      // [first, last) the vertices, either winding
+      template <typename FwdIt, typename Coor>
+      void polygon(FwdIt first, FwdIt last, Coor coor)
+      {
+        const size_t n = std::distance(first, last);
+        assert(n > 0);
+        std::vector<T> px, py;
+        ref[0] = ref[1] = T(0);
+        for (FwdIt it = first; it != last; ++it)
+        {
+          px.push_back(coor(*it, 0));
+          py.push_back(coor(*it, 1));
+          ref[0] += px.back() / T(n);
+          ref[1] += py.back() / T(n);
+        }
+        for (size_t i = 0; i < n; ++i) { px[i] -= ref[0]; py[i] -= ref[1]; }
+        x0 = *std::min_element(px.begin(), px.end()); x1 = *std::max_element(px.begin(), px.end());
+        y0 = *std::min_element(py.begin(), py.end()); y1 = *std::max_element(py.begin(), py.end());
+        for (size_t i = 0; i < n; ++i)
+        {
+          const size_t j = (i + 1) % n;
+          const T x = py[i] - py[j];
+          const T y = px[j] - px[i];
+          if (x == T(0) && y == T(0)) continue;
+          T l = x * px[0] + y * py[0], h = l;
+          for (size_t k = 1; k < n; ++k)
+          {
+            const T p = x * px[k] + y * py[k];
+            l = std::min(l, p);
+            h = std::max(h, p);
+          }
+          add_axis(x, y, l, h);
+        }
+        if (nx.empty()) add_axis(T(1), T(0), x0, x1);
+        pad();
+      }
+
+      // box around (cx, cy) with half extents hu along u and hv across
+      void obb(T cx, T cy, T ux, T uy, T hu, T hv)
+      {
+        const T len = std::sqrt(ux * ux + uy * uy);
+        assert(len > T(0));
+        ux /= len; uy /= len;
+        ref[0] = cx; ref[1] = cy;
+        const T ex = hu * std::abs(ux) + hv * std::abs(uy);
+        const T ey = hu * std::abs(uy) + hv * std::abs(ux);
+        x0 = -ex; x1 = ex; y0 = -ey; y1 = ey;
+        add_axis(ux, uy, -hu, hu);
+        add_axis(-uy, ux, -hv, hv);
+        pad();
+      }
+    };
+
+
+    // Separating axes test of the box with center ref + (dx, dy) and
+    // radii (rx, ry). Dispatched on the simd type of 2D points with
+    // scalar T, the vectorized version lives in
+    // arch/simd/shape_intersect_policy_impl.hpp.
+    template <typename simd_vec, typename T>
+    bool convex_sat_impl(simd_vec, const convex_shape<T>& s, T dx, T dy, T rx, T ry);
+
+
+    template <typename T>
+    inline bool convex_sat_impl(unsupported, const convex_shape<T>& s, T dx, T dy, T rx, T ry)
+    {
+      if (!s.bounds(dx, dy, rx, ry)) return false;
+      for (size_t i = 0; i < s.nx.size(); ++i)
+      {
+        const T p = dx * s.nx[i] + dy * s.ny[i];
+        const T e = rx * s.ax[i] + ry * s.ay[i];
+        if ((p - e > s.hi[i]) || (p + e < s.lo[i])) return false;
+      }
+      return true;
+    }
+
+
+    template <typename T>
+    inline bool convex_sat(const convex_shape<T>& s, T dx, T dy, T rx, T ry)
+    {
+      return convex_sat_impl(typename simd_type_impl<2, T>::type(), s, dx, dy, rx, ry);
+    }
+
+
+    // box of rhs relative to ref
+    template <typename Mbr, typename T>
+    inline void mbr_relative(const Mbr& rhs, const T* ref, T& dx, T& dy, T& rx, T& ry)
+    {
+      typedef typename traits::point_type<Mbr>::type point;
+      typedef traits::point_access<point> pa;
+      const auto* lo = pa::ptr(traits::mbr_access<Mbr>::get_min(rhs));
+      const auto* hi = pa::ptr(traits::mbr_access<Mbr>::get_max(rhs));
+      dx = T(0.5) * (lo[0] + hi[0]) - ref[0];
+      dy = T(0.5) * (lo[1] + hi[1]) - ref[1];
+      rx = T(0.5) * (hi[0] - lo[0]);
+      ry = T(0.5) * (hi[1] - lo[1]);
+    }
+
+
+    // the box with center center + (dx, dy) and radii (rx, ry)
+    // overlaps the disc of radius r around center
+    template <typename T>
+    inline bool disc_overlap(T dx, T dy, T rx, T ry, T r)
+    {
+      const T qx = std::max(std::abs(dx) - rx, T(0));
+      const T qy = std::max(std::abs(dy) - ry, T(0));
+      return qx * qx + qy * qy <= r * r;
+    }
+
+
+    // as above, for the ring r0 <= distance <= r1
+    template <typename T>
+    inline bool annulus_overlap(T dx, T dy, T rx, T ry, T r0, T r1)
+    {
+      const T fx = std::abs(dx) + rx;
+      const T fy = std::abs(dy) + ry;
+      return (fx * fx + fy * fy >= r0 * r0) && disc_overlap(dx, dy, rx, ry, r1);
+    }
+
+  }
+
+
+  // Mbr overlaps a convex polygon.
+  template <typename Mbr>
+  class convex_polygon_intersect_policy
+  {
+    typedef typename traits::point_type<Mbr>::type point;
+    typedef typename traits::point_scalar<point>::type scalar;
+    static_assert(traits::point_dim<point>::value == 2, "convex_polygon_intersect_policy: 2D only");
+
+  public:
+    // [first, last) the vertices, either winding
+    template <typename FwdIt>
+    convex_polygon_intersect_policy(FwdIt first, FwdIt last)
+    {
+      typedef typename std::iterator_traits<FwdIt>::value_type P;
+      shape_.polygon(first, last, [](const P& p, int d) { return scalar(traits::point_access<P>::ptr(p)[d]); });
+    }
+
+    bool operator()(const Mbr& rhs) const
+    {
+      scalar dx, dy, rx, ry;
+      detail::mbr_relative(rhs, shape_.ref, dx, dy, rx, ry);
+      return detail::convex_sat(shape_, dx, dy, rx, ry);
+    }
+
+  private:
+    detail::convex_shape<scalar> shape_;
+  };
+
+
+  // Mbr overlaps an oriented box.
+  template <typename Mbr>
+  class obb_intersect_policy
+  {
+    typedef typename traits::point_type<Mbr>::type point;
+    typedef typename traits::point_scalar<point>::type scalar;
+    static_assert(traits::point_dim<point>::value == 2, "obb_intersect_policy: 2D only");
+
+  public:
+    // half extents hu along axis u, hv across. u needs not to be normalized.
+    obb_intersect_policy(const point& center, const point& u, scalar hu, scalar hv)
+    {
+      typedef traits::point_access<point> pa;
+      shape_.obb(pa::ptr(center)[0], pa::ptr(center)[1], pa::ptr(u)[0], pa::ptr(u)[1], hu, hv);
+    }
+
+    bool operator()(const Mbr& rhs) const
+    {
+      scalar dx, dy, rx, ry;
+      detail::mbr_relative(rhs, shape_.ref, dx, dy, rx, ry);
+      return detail::convex_sat(shape_, dx, dy, rx, ry);
+    }
+
+  private:
+    detail::convex_shape<scalar> shape_;
+  };
+
+
+  // Mbr overlaps a disc.
+  template <typename Mbr>
+  class disc_intersect_policy
+  {
+    typedef typename traits::point_type<Mbr>::type point;
+    typedef typename traits::point_scalar<point>::type scalar;
+    static_assert(traits::point_dim<point>::value == 2, "disc_intersect_policy: 2D only");
+
+  public:
+    disc_intersect_policy(const point& center, scalar r) : r_(r)
+    {
+      typedef traits::point_access<point> pa;
+      ref_[0] = pa::ptr(center)[0];
+      ref_[1] = pa::ptr(center)[1];
+    }
+
+    bool operator()(const Mbr& rhs) const
+    {
+      scalar dx, dy, rx, ry;
+      detail::mbr_relative(rhs, ref_, dx, dy, rx, ry);
+      return detail::disc_overlap(dx, dy, rx, ry, r_);
+    }
+
+  private:
+    scalar ref_[2];
+    scalar r_;
+  };
+
+
+  // Mbr overlaps the ring r0 <= distance <= r1 around center.
+  template <typename Mbr>
+  class annulus_intersect_policy
+  {
+    typedef typename traits::point_type<Mbr>::type point;
+    typedef typename traits::point_scalar<point>::type scalar;
+    static_assert(traits::point_dim<point>::value == 2, "annulus_intersect_policy: 2D only");
+
+  public:
+    annulus_intersect_policy(const point& center, scalar r0, scalar r1) : r0_(r0), r1_(r1)
+    {
+      typedef traits::point_access<point> pa;
+      ref_[0] = pa::ptr(center)[0];
+      ref_[1] = pa::ptr(center)[1];
+    }
+
+    bool operator()(const Mbr& rhs) const
+    {
+      scalar dx, dy, rx, ry;
+      detail::mbr_relative(rhs, ref_, dx, dy, rx, ry);
+      return detail::annulus_overlap(dx, dy, rx, ry, r0_, r1_);
+    }
+
+  private:
+    scalar ref_[2];
+    scalar r0_, r1_;
+  };
+
+}
+
+
+#if (defined(HRTREE_HAS_AVX) || defined(HRTREE_HAS_SSE2))
+  #include <hrtree/arch/simd/shape_intersect_policy_impl.hpp>
+#endif
+
+
+#endif
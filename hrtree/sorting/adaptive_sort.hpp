@@ -0,0 +1,182 @@
+// hrtree/sorting/adaptive_sort.hpp header file
+//
+// Part of the Hilbert Rtree library.
+// Copyright (c) 2000-2014 Hanno Hildenbrandt
+//
+// This software is provided "as is" without express or implied warranty,
+// and with no claim as to its suitability for any purpose.
+//
+// Repair of nearly sorted sequences, e.g. Hilbert orders regenerated
+// in the order of the previous step. Linear in N for small disorder.
+
+#ifndef HRTREE_SORTING_ADAPTIVE_SORT_HPP
+#define HRTREE_SORTING_ADAPTIVE_SORT_HPP
+
+#include <iterator>
+#include <algorithm>
+#include <functional>
+#include <hrtree/config.hpp>
+#include <hrtree/sorting/insertion_sort.hpp>
+
+
+namespace hrtree { namespace sorting {
+
+
+  enum adaptive_sort_result
+  {
+    adaptive_sorted,          // [first, last) is sorted
+    adaptive_too_unsorted     // nothing done, use a full sort
+  };
+
+
+  // Disorder of a sequence.
+  struct sort_disorder
+  {
+    size_t descents;          // number of i with x[i] < x[i-1]
+    bool local;               // all descents satisfy x[i-window] <= x[i] and x[i-1] <= x[i+window]
+  };
+
+
+namespace detail {
+
+
+  static const size_t adaptive_sort_window = 16;
+  static const size_t adaptive_sort_max_shifts = 2;    // per item
+
+
+  // Stops counting after max_descents.
+  template <typename RaIt, typename Comperator>
+  inline sort_disorder measure_disorder_impl(RaIt first, const size_t N, const Comperator& cmp, size_t max_descents)
+  {
+    sort_disorder d = { 0, true };
+    for (size_t i = 1; i < N; ++i)
+    {
+      if (cmp(*(first + i), *(first + i - 1)))
+      {
+        if (++d.descents > max_descents) break;
+        if (i < adaptive_sort_window || cmp(*(first + i), *(first + i - adaptive_sort_window)))
+        {
+          d.local = false;
+        }
+        else if (i + adaptive_sort_window < N && cmp(*(first + i + adaptive_sort_window), *(first + i - 1)))
+        {
+          d.local = false;    // x[i-1] jumped forward
+        }
+      }
+    }
+    return d;
+  }
+
+
+  // Insertion sort that gives up after max_shifts moves. Returns false
+  // if it gave up, [first, first + N) is a permutation of the input then.
+  template <typename RaIt, typename Comperator>
+  inline bool bounded_insertion_sort_impl(RaIt first, const size_t N, const Comperator& cmp, size_t max_shifts)
+  {
+    size_t shifts = 0;
+    for (size_t i = 1; i < N; ++i)
+    {
+      if (cmp(*(first + i), *(first + i - 1)))
+      {
+        typename std::iterator_traits<RaIt>::value_type pivot = *(first + i);
+        size_t j = i;
+        for (; j > 0 && cmp(pivot, *(first + j - 1)); --j)
+        {
+          *(first + j) = *(first + j - 1);
+        }
+        *(first + j) = pivot;
+        shifts += i - j;
+        if (shifts > max_shifts) return false;
+      }
+    }
+    return true;
+  }
+
+
+  // Moves the items that break a non-decreasing run into buf and merges
+  // them back. An item smaller than the last kept one is extracted together
+  // with the latter, which bounds the number of extracted items by twice
+  // the number of removed inversions.
+  template <typename RaIt, typename Comperator>
+  inline void extract_merge_impl(RaIt first, const size_t N, RaIt buf, const Comperator& cmp)
+  {
+    size_t K = 0;   // kept
+    size_t M = 0;   // extracted
+    for (size_t i = 0; i < N; ++i)
+    {
+      if (K && cmp(*(first + i), *(first + K - 1)))
+      {
+        *(buf + M++) = *(first + --K);
+        *(buf + M++) = *(first + i);
+      }
+      else
+      {
+        *(first + K++) = *(first + i);
+      }
+    }
+    std::sort(buf, buf + M, cmp);
+
+    // merge backwards in place, the write position never overtakes the kept reads
+    size_t dst = N;
+    while (M)
+    {
+      if (K && cmp(*(buf + M - 1), *(first + K - 1)))
+      {
+        *(first + --dst) = *(first + --K);
+      }
+      else
+      {
+        *(first + --dst) = *(buf + --M);
+      }
+    }
+  }
+
+
+}
+
+
+  template <typename RaIt, typename Comperator>
+  inline sort_disorder measure_disorder(RaIt first, RaIt last, const Comperator& cmp)
+  {
+    return detail::measure_disorder_impl(first, size_t(last - first), cmp, size_t(-1));
+  }
+
+
+  //! Sorts nearly sorted data in [first,last) in place.
+  //! buf must hold (last - first) items.
+  //! Local disorder is repaired by insertion sort, scattered disorder by
+  //! extraction of the out-of-order items and merge. Insertion sort is
+  //! bounded to 2N moves, which keeps the repair linear. Returns adaptive_too_unsorted
+  //! without touching the data if more than 1/max_disorder_ratio of the
+  //! positions are descents.
+  template <typename RaIt, typename Comperator>
+  inline adaptive_sort_result adaptive_sort(RaIt first, RaIt last, RaIt buf, const Comperator& cmp, size_t max_disorder_ratio = 16)
+  {
+    const size_t N = size_t(last - first);
+    const sort_disorder d = detail::measure_disorder_impl(first, N, cmp, N / max_disorder_ratio);
+    if (0 == d.descents) return adaptive_sorted;
+    if (d.descents > N / max_disorder_ratio) return adaptive_too_unsorted;
+    // insertion sort bails out if the disorder wasn't as local as it looked
+    if (!d.local || !detail::bounded_insertion_sort_impl(first, N, cmp, detail::adaptive_sort_max_shifts * N))
+    {
+      detail::extract_merge_impl(first, N, buf, cmp);
+    }
+    return adaptive_sorted;
+  }
+
+
+  template <typename RaIt>
+  inline adaptive_sort_result adaptive_sort(RaIt first, RaIt last, RaIt buf)
+  {
+    typedef typename std::iterator_traits<RaIt>::value_type T;
+    return adaptive_sort(first, last, buf, std::less<T>());
+  }
+
+}
+
+using sorting::adaptive_sort;
+using sorting::measure_disorder;
+
+}
+
+#endif
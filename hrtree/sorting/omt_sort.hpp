@@ -0,0 +1,186 @@
+// hrtree/sorting/omt_sort.hpp header file
+//
+// Part of the Hilbert Rtree library.
+// Copyright (c) 2000-2014 Hanno Hildenbrandt
+//
+// This software is provided "as is" without express or implied warranty,
+// and with no claim as to its suitability for any purpose.
+//
+// Top-down (OMT style) order for the implicit rtree layout.
+// Every node is partitioned along the longest axis of its elements
+// into slices of whole children. Slower than a curve or STR order,
+// meant for long-lived trees where queries dominate.
+
+#ifndef HRTREE_SORTING_OMT_SORT_HPP
+#define HRTREE_SORTING_OMT_SORT_HPP
+
+#include <array>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+#include <hrtree/config.hpp>
+#include <hrtree/adapt_point.hpp>
+#include <hrtree/arch/parallel.hpp>
+#include <hrtree/sorting/partition.hpp>
+#include <hrtree/sorting/parallel_partition.hpp>
+#include <hrtree/sorting/str_sort.hpp>
+
+
+namespace hrtree { namespace sorting {
+
+namespace detail {
+
+
+  // Moves the k-th smallest element along dimension d to first + k,
+  // not larger elements before, not smaller ones after. Large ranges
+  // are narrowed down by parallel_partition.
+  template <typename RaIt, typename Coor>
+  inline void omt_select(RaIt first, RaIt last, std::ptrdiff_t k, int d, const Coor& coor)
+  {
+    typedef typename std::iterator_traits<RaIt>::value_type T;
+    auto cmp = [d, &coor](const T& a, const T& b) { return coor(a, d) < coor(b, d); };
+    const RaIt nth = first + k;
+    while ((last - first) > 65536)
+    {
+      const auto pivot = coor(*(first + pseudo_median_of_nine(first, last, cmp)), d);
+      RaIt mid = hrtree::parallel_partition(first, last, [d, pivot, &coor](const T& x) { return coor(x, d) < pivot; });
+      if (mid == first)
+      {
+        // pivot is the minimum, split off the elements equal to it
+        mid = hrtree::parallel_partition(first, last, [d, pivot, &coor](const T& x) { return !(pivot < coor(x, d)); });
+        if (nth < mid) return;
+      }
+      if (nth < mid) last = mid; else first = mid;
+    }
+    std::nth_element(first, nth, last, cmp);
+  }
+
+
+  // Cuts [first, first + n) into s slices of slice_n elements
+  // along dimension d by recursive bisection.
+  template <typename RaIt, typename Coor>
+  inline void omt_slice(RaIt first, std::ptrdiff_t n, std::ptrdiff_t s, std::ptrdiff_t slice_n, int d, const Coor& coor)
+  {
+    if (s < 2) return;
+    const std::ptrdiff_t h = s / 2;
+    const std::ptrdiff_t k = h * slice_n;
+    omt_select(first, first + n, k, d, coor);
+    omt_slice(first, k, h, slice_n, d, coor);
+    omt_slice(first + k, n - k, s - h, slice_n, d, coor);
+  }
+
+
+  // Partitions the node [first, first + n) into children of B elements.
+  // The longest axis is cut first, each slice is cut again along its own
+  // longest axis until dims cuts are done.
+  template <int DIM, typename RaIt, typename Coor>
+  inline void omt_tile(RaIt first, std::ptrdiff_t n, std::ptrdiff_t B, int dims, const Coor& coor)
+  {
+    const std::ptrdiff_t children = (n + B - 1) / B;
+    if (children < 2) return;
+    auto lo = coor.point(*first), hi = lo;
+    for (RaIt it = first + 1; it != first + n; ++it)
+    {
+      const auto p = coor.point(*it);
+      for (int d = 0; d < DIM; ++d)
+      {
+        lo[d] = std::min(lo[d], p[d]);
+        hi[d] = std::max(hi[d], p[d]);
+      }
+    }
+    int axis = 0;
+    for (int d = 1; d < DIM; ++d)
+    {
+      if ((hi[d] - lo[d]) > (hi[axis] - lo[axis])) axis = d;
+    }
+    const std::ptrdiff_t slices = (dims > 1) ? str_slices(children, dims) : children;
+    const std::ptrdiff_t slice_n = ((children + slices - 1) / slices) * B;
+    const std::ptrdiff_t num_slices = (n + slice_n - 1) / slice_n;
+    omt_slice(first, n, num_slices, slice_n, axis, coor);
+    if (dims > 1)
+    {
+      for (std::ptrdiff_t s = 0; s < num_slices; ++s)
+      {
+        const std::ptrdiff_t i0 = s * slice_n;
+        omt_tile<DIM>(first + i0, std::min(slice_n, n - i0), B, dims - 1, coor);
+      }
+    }
+  }
+
+
+  // Orders the subtree [first, first + n) with children of B elements.
+  template <size_t LEAF_FANOUT, size_t NODE_FANOUT, int DIM, typename RaIt, typename Coor>
+  inline void omt_subtree(RaIt first, std::ptrdiff_t n, std::ptrdiff_t B, const Coor& coor)
+  {
+    omt_tile<DIM>(first, n, B, DIM, coor);
+    if (B == std::ptrdiff_t(LEAF_FANOUT)) return;
+    for (std::ptrdiff_t i0 = 0; i0 < n; i0 += B)
+    {
+      omt_subtree<LEAF_FANOUT, NODE_FANOUT, DIM>(first + i0, std::min(B, n - i0), B / NODE_FANOUT, coor);
+    }
+  }
+
+
+}
+
+
+  // Sorts [first, last) into a top-down order for an implicit rtree of the
+  // given fanouts: on every level l > 0, each run of LEAF_FANOUT *
+  // NODE_FANOUT^(l-1) elements starting at a multiple of it is a node,
+  // partitioned from its parent along the longest axis. point(x) returns the (adapted) point to sort element
+  // x by. The upper levels are partitioned one after the other, the
+  // subtrees below run in parallel.
+  template <size_t LEAF_FANOUT, size_t NODE_FANOUT = LEAF_FANOUT, typename RaIt, typename PointFun>
+  inline void omt_sort(RaIt first, RaIt last, PointFun point)
+  {
+    typedef typename std::iterator_traits<RaIt>::value_type T;
+    typedef typename std::decay<decltype(point(*first))>::type point_type;
+    typedef traits::point_access<point_type> pa;
+    typedef typename traits::point_scalar<point_type>::type scalar;
+    static const int DIM = traits::point_dim<point_type>::value;
+
+    struct coor_type
+    {
+      const PointFun& fun;
+      scalar operator()(const T& x, int d) const { return pa::ptr(fun(x))[d]; }
+      std::array<scalar, DIM> point(const T& x) const
+      {
+        std::array<scalar, DIM> p;
+        const auto& px = fun(x);
+        const scalar* ptr = pa::ptr(px);
+        std::copy(ptr, ptr + DIM, p.begin());
+        return p;
+      }
+    } coor{ point };
+
+    const std::ptrdiff_t N = last - first;
+    if (N <= std::ptrdiff_t(LEAF_FANOUT)) return;
+    std::ptrdiff_t B = LEAF_FANOUT;
+    while ((N + B - 1) / B > std::ptrdiff_t(NODE_FANOUT)) B *= NODE_FANOUT;
+    const std::ptrdiff_t min_nodes = 4 * std::ptrdiff_t(hrtree_max_num_threads());
+    for (std::ptrdiff_t P = B * NODE_FANOUT; B >= std::ptrdiff_t(LEAF_FANOUT); P = B, B /= NODE_FANOUT)
+    {
+      const std::ptrdiff_t nodes = (N + P - 1) / P;
+      if (nodes >= min_nodes)
+      {
+        arch::parallel_for_dynamic(std::ptrdiff_t(0), nodes, std::ptrdiff_t(1), [&](std::ptrdiff_t i)
+        {
+          detail::omt_subtree<LEAF_FANOUT, NODE_FANOUT, DIM>(first + i * P, std::min(P, N - i * P), B, coor);
+        });
+        return;
+      }
+      for (std::ptrdiff_t i = 0; i < nodes; ++i)
+      {
+        detail::omt_tile<DIM>(first + i * P, std::min(P, N - i * P), B, DIM, coor);
+      }
+    }
+  }
+
+
+}
+
+using sorting::omt_sort;
+
+}
+
+#endif
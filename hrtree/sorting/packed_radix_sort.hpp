@@ -0,0 +1,250 @@
+// hrtree/sorting/packed_radix_sort.hpp header file
+//
+// Part of the Hilbert Rtree library.
+// Copyright (c) 2000-2014 Hanno Hildenbrandt
+//
+// This software is provided "as is" without express or implied warranty,
+// and with no claim as to its suitability for any purpose.
+//
+// LSD radix sort of packed 64-bit key/index records:
+// key in the high bits, index in the low INDEX_BITS (default 32) bits.
+// Works on whole words with shifts, no converter involved.
+
+#ifndef HRTREE_SORTING_PACKED_RADIX_SORT_HPP
+#define HRTREE_SORTING_PACKED_RADIX_SORT_HPP
+
+#include <cstdint>
+#include <vector>
+#include <memory.h>
+#include <hrtree/config.hpp>
+#include <hrtree/arch/parallel.hpp>
+#include <hrtree/sorting/radix_sort.hpp>
+#include <hrtree/arch/select.hpp>
+
+
+namespace hrtree { namespace sorting {
+
+
+  typedef std::uint64_t packed_keyidx_t;
+
+
+  // 64 - INDEX_BITS key bits. INDEX_BITS > 32 trades key bits for
+  // more than 2^32 items, e.g. 30 bit Hilbert values and 34 bit indices.
+  template <int INDEX_BITS = 32>
+  inline packed_keyidx_t pack_keyidx(std::uint64_t key, std::uint64_t idx)
+  {
+    static_assert(0 < INDEX_BITS && INDEX_BITS < 64, "pack_keyidx: invalid INDEX_BITS");
+    return (key << INDEX_BITS) | idx;
+  }
+
+
+  template <int INDEX_BITS = 32>
+  inline std::uint64_t packed_key(packed_keyidx_t x) { return x >> INDEX_BITS; }
+
+  template <int INDEX_BITS = 32>
+  inline std::uint64_t packed_index(packed_keyidx_t x) { return x & ((packed_keyidx_t(1) << INDEX_BITS) - 1); }
+
+
+  // Packed records compare as unsigned words.
+  // Equal keys are ordered by index.
+  struct packed_less
+  {
+    bool operator()(packed_keyidx_t a, packed_keyidx_t b) const { return a < b; }
+  };
+
+
+namespace detail {
+
+
+  // Scalar histogram of all passes over [src, src + N).
+  template <typename I>
+  inline void packed_histogram_scalar(const packed_keyidx_t* src, I N, const radix_digits& rd, int key_shift, I* hist)
+  {
+    for (I i = 0; i < N; ++i)
+    {
+      const std::uint64_t key = (src[i] >> key_shift) & rd.key_mask;
+      for (int pass = 0; pass < rd.passes; ++pass)
+      {
+        ++hist[pass * rd.bins + rd.digit(key, pass)];
+      }
+    }
+  }
+
+}}}
+
+
+#if defined(HRTREE_HAS_AVX2)
+  #include <hrtree/arch/simd/packed_histogram_impl.hpp>
+#else
+namespace hrtree { namespace sorting { namespace detail {
+
+  template <typename I>
+  inline void packed_histogram(const packed_keyidx_t* src, I N, const radix_digits& rd, int key_shift, I* hist)
+  {
+    packed_histogram_scalar(src, N, rd, key_shift, hist);
+  }
+
+}}}
+#endif
+
+
+namespace hrtree { namespace sorting { namespace detail {
+
+
+  // Passes with a singular histogram are skipped.
+  template <typename I>
+  inline bool packed_radix_sort_impl(packed_keyidx_t* src, packed_keyidx_t* buf, const I N, const int key_bits, const int key_shift)
+  {
+    const radix_digits rd(key_bits);
+    std::vector<I> hist(rd.passes * rd.bins, 0);
+    packed_histogram(src, N, rd, key_shift, hist.data());
+    bool swaped = false;
+    for (int pass = 0; pass < rd.passes; ++pass)
+    {
+      I* const bins = hist.data() + pass * rd.bins;
+
+      // Reduce prefix table
+      I cumsum = 0;
+      for (int b = 0; b < rd.bins; ++b)
+      {
+        const I count = bins[b];
+        if (count == N) goto skip;
+        bins[b] = cumsum;
+        cumsum += count;
+      }
+
+      // Scatter
+      {
+        const int shift = key_shift + pass * rd.bits;
+        const std::uint64_t mask = rd.mask;
+        for (I i = 0; i < N; ++i)
+        {
+          const packed_keyidx_t x = src[i];
+          buf[bins[(x >> shift) & mask]++] = x;
+        }
+      }
+      std::swap(src, buf);
+      swaped = !swaped;
+skip:
+      ;
+    }
+    return swaped;
+  }
+
+
+  template <typename I>
+  inline bool parallel_packed_radix_sort_impl(packed_keyidx_t* first, packed_keyidx_t* buffer, const I N, const int key_bits, const int key_shift)
+  {
+    const radix_digits rd(key_bits);
+    const int numt = hrtree_max_num_threads();
+    const int stride = rd.passes * rd.bins;
+    std::vector<I> Bins(numt * stride);
+    bool Swaped = false;
+    arch::parallel_region(numt, N > 100*numt, [&](arch::team& team)
+    {
+      packed_keyidx_t* src = first;
+      packed_keyidx_t* buf = buffer;
+      std::vector<I> prefix(rd.bins);
+      const int nt = team.num_threads();
+      const int tid = team.thread_num();
+      const I chunk = N / nt;
+      const I i0 = tid * chunk;
+      const I i1 = (tid == nt-1) ? N : i0 + chunk;
+      I* const bins = Bins.data() + tid * stride;
+      memset(bins, 0, stride * sizeof(I));
+      packed_histogram(src + i0, i1 - i0, rd, key_shift, bins);
+
+      team.barrier();
+
+      // Global skip, decided before any histogram is recounted
+      bool skip[radix_digits::max_passes] = {};
+      for (int pass = 0; pass < rd.passes; ++pass)
+      {
+        for (int b = 0; b < rd.bins && !skip[pass]; ++b)
+        {
+          I count = 0;
+          for (int t = 0; t < nt; ++t) count += Bins[t * stride + pass * rd.bins + b];
+          skip[pass] = (count == N);
+        }
+      }
+
+      bool recount = false;
+      for (int pass = 0; pass < rd.passes; ++pass)
+      {
+        if (skip[pass]) continue;
+        const int ofs = pass * rd.bins;
+        const int shift = key_shift + pass * rd.bits;
+        const std::uint64_t mask = rd.mask;
+        if (recount)
+        {
+          // the data has moved since the up-front count
+          memset(bins + ofs, 0, rd.bins * sizeof(I));
+          for (I i = i0; i < i1; ++i)
+          {
+            ++bins[ofs + ((src[i] >> shift) & mask)];
+          }
+          team.barrier();
+        }
+        recount = true;
+        if (tid == 0) Swaped = !Swaped;   // no flush
+
+        // Reduce global prefix table
+        I cumsum = 0;
+        for (int b = 0; b < rd.bins; ++b)
+        {
+          for (int t=0; t<tid; ++t) cumsum += Bins[t * stride + ofs + b];
+          prefix[b] = cumsum;
+          for (int t=tid; t<nt; ++t) cumsum += Bins[t * stride + ofs + b];
+        }
+
+        // Scatter
+        for (I i = i0; i < i1; ++i)
+        {
+          const packed_keyidx_t x = src[i];
+          buf[prefix[(x >> shift) & mask]++] = x;
+        }
+        std::swap(src, buf);
+        team.barrier();
+      }
+    });
+    return Swaped;
+  }
+
+
+}  // namespace detail
+
+
+// Sorts packed key/index records by their keys, which must be < 2^key_bits.
+// Returns true if the result ended up in buf.
+template < int INDEX_BITS = 32, typename RaIt >
+inline bool packed_radix_sort(RaIt first, RaIt last, RaIt buf, int key_bits = 64 - INDEX_BITS)
+{
+  const std::ptrdiff_t N = last - first;
+  if (N <= 1) return false;
+  return (N <= INT_MAX) ? detail::packed_radix_sort_impl(&*first, &*buf, int(N), key_bits, INDEX_BITS)
+                        : detail::packed_radix_sort_impl(&*first, &*buf, N, key_bits, INDEX_BITS);
+}
+
+
+template < int INDEX_BITS = 32, typename RaIt >
+inline bool parallel_packed_radix_sort(RaIt first, RaIt last, RaIt buf, int key_bits = 64 - INDEX_BITS)
+{
+  const std::ptrdiff_t N = last - first;
+  if (N <= 1) return false;
+  return (N <= INT_MAX) ? detail::parallel_packed_radix_sort_impl(&*first, &*buf, int(N), key_bits, INDEX_BITS)
+                        : detail::parallel_packed_radix_sort_impl(&*first, &*buf, N, key_bits, INDEX_BITS);
+}
+
+
+}
+
+using sorting::packed_keyidx_t;
+using sorting::pack_keyidx;
+using sorting::packed_key;
+using sorting::packed_index;
+using sorting::packed_radix_sort;
+using sorting::parallel_packed_radix_sort;
+
+}
+
+#endif
@@ -9,7 +9,9 @@
 #ifndef HRTREE_SORTING_PARALLEL_PARTITION_HPP
 #define HRTREE_SORTING_PARALLEL_PARTITION_HPP
 
+#include <vector>
 #include <hrtree/config.hpp>
+#include <hrtree/arch/parallel.hpp>
 #include <hrtree/sorting/partition.hpp>
 
 
@@ -17,7 +19,7 @@ namespace hrtree { namespace detail {
 
 
   template <int Block>
-  inline int& incr(int& i, int stride)
+  inline std::ptrdiff_t& incr(std::ptrdiff_t& i, std::ptrdiff_t stride)
   {
     ++i; if (0 == (i % Block)) i += stride - Block;
     return i; 
@@ -25,7 +27,7 @@ namespace hrtree { namespace detail {
 
   
   template <int Block>
-  inline int& decr(int& i, int stride)
+  inline std::ptrdiff_t& decr(std::ptrdiff_t& i, std::ptrdiff_t stride)
   {
     if (0 == (i % stride)) i -= stride - Block;
     return --i; 
@@ -33,16 +35,16 @@ namespace hrtree { namespace detail {
   
 
   template <int Block, typename ZIt, typename Predicate>
-  inline int block_partition(ZIt first, ZIt last, int stride, Predicate pred)
+  inline std::ptrdiff_t block_partition(ZIt first, ZIt last, std::ptrdiff_t stride, Predicate pred)
   {
     using namespace hrtree::zip;
 
-    const int N = int(last - first);
-    int i0 = 0;
-    int i1 = N;
-    int strides = i1 / stride;
-    int lastBlock = stride * strides + Block;
-    i1 = std::min<int>(lastBlock, i1);
+    const std::ptrdiff_t N = last - first;
+    std::ptrdiff_t i0 = 0;
+    std::ptrdiff_t i1 = N;
+    std::ptrdiff_t strides = i1 / stride;
+    std::ptrdiff_t lastBlock = stride * strides + Block;
+    i1 = std::min<std::ptrdiff_t>(lastBlock, i1);
 
     for (;; incr<Block>(i0, stride))
     {
@@ -56,7 +58,7 @@ namespace hrtree { namespace detail {
         break;
       std::iter_swap(first + i0, first + i1);
     }
-    return std::min<int>(i0, N);
+    return std::min<std::ptrdiff_t>(i0, N);
   }
 
 
@@ -68,27 +70,27 @@ namespace hrtree { namespace detail {
   template<typename ZIt, typename Predicate>
   inline ZIt parallel_partition(ZIt first, ZIt last, Predicate pred)
   {
-    int mt = std::min<int>(omp_get_max_threads(), HRTREE_OMP_MAX_THREADS);
-    const int mstride = mt * HRTREE_PARALLEL_PARTITION_BLOCK;
+    const int numt = hrtree_max_num_threads();
+    int mt = numt;
+    const std::ptrdiff_t mstride = std::ptrdiff_t(mt) * HRTREE_PARALLEL_PARTITION_BLOCK;
     if (mt < 2 || ((last - first) < mstride))
     {
       return ::hrtree::partition(first, last, pred);
     }
-    int pivot[HRTREE_OMP_MAX_THREADS];
-    const int numt = hrtree_max_num_threads();
-#   pragma omp parallel firstprivate(first, last) num_threads(numt)
+    std::vector<std::ptrdiff_t> pivot(numt);
+    arch::parallel_region(numt, true, [&](arch::team& team)
     {
-      const int nt = omp_get_num_threads();
-      const int tid = omp_get_thread_num();
-      const int stride = nt * HRTREE_PARALLEL_PARTITION_BLOCK;
-      const int ofs = tid * HRTREE_PARALLEL_PARTITION_BLOCK;
+      const int nt = team.num_threads();
+      const int tid = team.thread_num();
+      const std::ptrdiff_t stride = std::ptrdiff_t(nt) * HRTREE_PARALLEL_PARTITION_BLOCK;
+      const std::ptrdiff_t ofs = std::ptrdiff_t(tid) * HRTREE_PARALLEL_PARTITION_BLOCK;
       pivot[tid] = ofs + detail::block_partition<HRTREE_PARALLEL_PARTITION_BLOCK>(
         first + ofs, last, stride, pred
         );
       if (tid == 0) mt = nt;
-    }
+    });
     // Cleanup
-    std::pair<const int*, const int*> c = std::minmax_element(pivot, pivot + mt);
+    auto c = std::minmax_element(pivot.cbegin(), pivot.cbegin() + mt);
     return ::hrtree::partition(first + *c.first, first + *c.second, pred);
   }
 
@@ -12,11 +12,13 @@
 #include <iterator>
 #include <algorithm>
 #include <stack>
+#include <mutex>
+#include <atomic>
 #include <hrtree/config.hpp>
+#include <hrtree/arch/parallel.hpp>
 #include <hrtree/zip/zip.hpp>
 #include <hrtree/sorting/quick_sort.hpp>
 #include <hrtree/sorting/parallel_partition.hpp>
-#include <hrtree/arch/select.hpp>                   // _mm_pause
 
 
 namespace hrtree { namespace sorting { namespace detail {
@@ -52,23 +54,23 @@ namespace hrtree { namespace sorting { namespace detail {
     ZIt mid = parallel_partition(first, last, pred);
     stack.push(std::make_pair(first, mid));
     stack.push(std::make_pair(mid, last));
-    int Load = 0;
-    bool Empty = 0;
-    const int numt = hrtree_max_num_threads();
-#   pragma omp parallel num_threads(numy)
+    std::mutex mutex;
+    std::atomic<int> Load(0);
+    std::atomic<bool> Empty(false);
+    arch::parallel_region([&](arch::team&)
     {
       std::pair< ZIt, ZIt > part;
       bool empty = false;
       while (Load || !Empty)
       {
-#       pragma omp critical (hrtree_parallel_quick_sort)
         {
-          empty = Empty = stack.empty();
+          std::lock_guard<std::mutex> lock(mutex);
+          empty = stack.empty();
+          Empty = empty;
           if (!empty) 
           {
             part = stack.top();
             stack.pop();
-#           pragma omp atomic
             ++Load;
           } 
         }
@@ -83,26 +85,19 @@ namespace hrtree { namespace sorting { namespace detail {
             else
             {
               ZIt mid = hrtree::unguarded_partition(part.first, part.second, cmp);
-#             pragma omp critical (hrtree_parallel_quick_sort)
-              {
-                stack.push(std::make_pair(part.first, mid));
-                stack.push(std::make_pair(mid, part.second));
-                Empty = false;
-              }
+              std::lock_guard<std::mutex> lock(mutex);
+              stack.push(std::make_pair(part.first, mid));
+              stack.push(std::make_pair(mid, part.second));
+              Empty = false;
             }
           }
-#         pragma omp atomic
           --Load;
         }
-#       pragma omp flush(Load)
         // Spin wait for more work
-        while (Load && Empty)
-        {
-#         pragma omp flush(Load, Empty)
-          _mm_pause();
-        }
+        arch::backoff wait;
+        while (Load && Empty) wait();
       }
-    }
+    });
   }
 
 
@@ -10,35 +10,38 @@
 #define HRTREE_SORTING_PARALLEL_RADIX_SORT_HPP
 
 #include <algorithm>
+#include <vector>
 #include <hrtree/config.hpp>
+#include <hrtree/arch/parallel.hpp>
 #include <hrtree/sorting/radix_sort.hpp>
 
 
 namespace hrtree { namespace sorting { namespace detail {
 
 
-  template <typename ZIt, typename CONV>
-  inline bool parallel_radix_sort_impl(ZIt src, ZIt buf, const int N, CONV conv, const int key_bytes)
+  template <typename ZIt, typename I, typename CONV>
+  inline bool parallel_radix_sort_bytes_impl(ZIt first, ZIt buffer, const I N, CONV conv, const int key_bytes)
   {
-    HRTREE_ALIGN_CACHELINE int Bins[HRTREE_OMP_MAX_THREADS][UINT8_MAX+1];
-    int SingularBin[HRTREE_OMP_MAX_THREADS];
-    bool Swaped = false;
     const int numt = hrtree_max_num_threads();
-#   pragma omp parallel if(N>100*HRTREE_OMP_MAX_THREADS) firstprivate(src, buf, conv, key_bytes) num_threads(numt)
+    std::vector<I> Bins(numt * (UINT8_MAX+1));
+    std::vector<int> SingularBin(numt);
+    bool Swaped = false;
+    arch::parallel_region(numt, N > 100*numt, [&](arch::team& team)
     {
-      int prefix[UINT8_MAX+1];
-      const int nt = omp_get_num_threads();
-      const int tid = omp_get_thread_num();
-      const int chunk = N / nt;
-      const int i0 = tid * chunk;
-      const int i1 = (tid == nt-1) ? N : i0 + chunk;
-      const int n = i1 - i0;
-      int* const bins = Bins[tid];
+      ZIt src(first), buf(buffer);
+      I prefix[UINT8_MAX+1];
+      const int nt = team.num_threads();
+      const int tid = team.thread_num();
+      const I chunk = N / nt;
+      const I i0 = tid * chunk;
+      const I i1 = (tid == nt-1) ? N : i0 + chunk;
+      const I n = i1 - i0;
+      I* const bins = Bins.data() + tid * (UINT8_MAX+1);
       for (int byte = 0; byte < key_bytes; ++byte)
       {
-        memset(bins, 0, (UINT8_MAX+1)*sizeof(int));
+        memset(bins, 0, (UINT8_MAX+1)*sizeof(I));
         auto src0(zip::head(src));
-        for (int i = i0; i < i1; ++i)
+        for (I i = i0; i < i1; ++i)
         {
           std::uint8_t key = *(conv(*(src0 + i)) + byte);
           ++bins[key];
@@ -50,7 +53,7 @@ namespace hrtree { namespace sorting { namespace detail {
         }
         SingularBin[tid] = sb;
 
-#       pragma omp barrier
+        team.barrier();
 
         // Global skip?
         bool skip = SingularBin[0] >= 0;
@@ -61,47 +64,142 @@ namespace hrtree { namespace sorting { namespace detail {
           if (tid == 0) Swaped = !Swaped;   // no flush
 
           // Reduce global prefix table
-          int cumsum = 0;
+          I cumsum = 0;
           for (int b = 0; b <= UINT8_MAX; ++b)
           {
-            for (int t=0; t<tid; ++t) cumsum += Bins[t][b];
+            for (int t=0; t<tid; ++t) cumsum += Bins[t * (UINT8_MAX+1) + b];
             prefix[b] = cumsum;
-            for (int t=tid; t<nt; ++t) cumsum += Bins[t][b];
+            for (int t=tid; t<nt; ++t) cumsum += Bins[t * (UINT8_MAX+1) + b];
           }
 
           // Scatter
-          for (int i = i0; i < i1; ++i)
+          for (I i = i0; i < i1; ++i)
           {
             std::uint8_t key = *(conv(*(src0 + i)) + byte);
             zip::iter_move(src, buf, i, prefix[key]++);
           }
           std::swap(src, buf);
-#         pragma omp barrier 
-          ;
         }
+        // SingularBin and Bins are rewritten by the next byte
+        team.barrier();
       }
+    });
+    return Swaped;
+  }
+
+
+  // Parallel LSD radix sort with digit width derived from the number of key bits.
+  // The histograms of all passes are gathered in a single read pass, which
+  // identifies the passes that can be skipped. The per-thread histograms
+  // are only valid for the first pass, later passes recount their chunk.
+  template <typename ZIt, typename I, typename CONV>
+  inline bool parallel_radix_sort_impl(ZIt first, ZIt buffer, const I N, CONV conv, const int key_bits)
+  {
+    if (key_bits > 64)
+    {
+      return parallel_radix_sort_bytes_impl(first, buffer, N, conv, (key_bits + CHAR_BIT - 1) / CHAR_BIT);
     }
+    const radix_digits rd(key_bits);
+    const int numt = hrtree_max_num_threads();
+    const int stride = rd.passes * rd.bins;
+    std::vector<I> Bins(numt * stride);
+    bool Swaped = false;
+    arch::parallel_region(numt, N > 100*numt, [&](arch::team& team)
+    {
+      ZIt src(first), buf(buffer);
+      std::vector<I> prefix(rd.bins);
+      const int nt = team.num_threads();
+      const int tid = team.thread_num();
+      const I chunk = N / nt;
+      const I i0 = tid * chunk;
+      const I i1 = (tid == nt-1) ? N : i0 + chunk;
+      I* const bins = Bins.data() + tid * stride;
+      memset(bins, 0, stride * sizeof(I));
+      {
+        auto src0(zip::head(src));
+        for (I i = i0; i < i1; ++i)
+        {
+          const std::uint64_t key = load_key_word(conv, *(src0 + i)) & rd.key_mask;
+          for (int pass = 0; pass < rd.passes; ++pass)
+          {
+            ++bins[pass * rd.bins + rd.digit(key, pass)];
+          }
+        }
+      }
+
+      team.barrier();
+
+      // Global skip, decided before any histogram is recounted
+      bool skip[radix_digits::max_passes] = {};
+      for (int pass = 0; pass < rd.passes; ++pass)
+      {
+        for (int b = 0; b < rd.bins && !skip[pass]; ++b)
+        {
+          I count = 0;
+          for (int t = 0; t < nt; ++t) count += Bins[t * stride + pass * rd.bins + b];
+          skip[pass] = (count == N);
+        }
+      }
+
+      bool recount = false;
+      for (int pass = 0; pass < rd.passes; ++pass)
+      {
+        if (skip[pass]) continue;
+        const int ofs = pass * rd.bins;
+        auto src0(zip::head(src));
+        if (recount)
+        {
+          // the data has moved since the up-front count
+          memset(bins + ofs, 0, rd.bins * sizeof(I));
+          for (I i = i0; i < i1; ++i)
+          {
+            const std::uint64_t key = load_key_word(conv, *(src0 + i)) & rd.key_mask;
+            ++bins[ofs + rd.digit(key, pass)];
+          }
+          team.barrier();
+        }
+        recount = true;
+        if (tid == 0) Swaped = !Swaped;   // no flush
+
+        // Reduce global prefix table
+        I cumsum = 0;
+        for (int b = 0; b < rd.bins; ++b)
+        {
+          for (int t=0; t<tid; ++t) cumsum += Bins[t * stride + ofs + b];
+          prefix[b] = cumsum;
+          for (int t=tid; t<nt; ++t) cumsum += Bins[t * stride + ofs + b];
+        }
+
+        // Scatter
+        for (I i = i0; i < i1; ++i)
+        {
+          const std::uint64_t key = load_key_word(conv, *(src0 + i)) & rd.key_mask;
+          zip::iter_move(src, buf, i, prefix[rd.digit(key, pass)]++);
+        }
+        std::swap(src, buf);
+        team.barrier();
+      }
+    });
     return Swaped;
   }
 
 
-  template <typename ZIt, typename CONV>
-  inline void parallel_inplace_msl_radix_sort_impl(ZIt src, const int N, CONV conv, int byte)
+  template <typename ZIt, typename I, typename CONV>
+  inline void parallel_inplace_msl_radix_sort_impl(ZIt src, const I N, CONV conv, int byte)
   {
-    HRTREE_ALIGN_CACHELINE int bins[UINT8_MAX+1];
-    HRTREE_ALIGN_CACHELINE int ends[UINT8_MAX+1];
+    HRTREE_ALIGN_CACHELINE I bins[UINT8_MAX+1];
+    HRTREE_ALIGN_CACHELINE I ends[UINT8_MAX+1];
 
     byte = inplace_msd_radix_sort_prepare(src, N, conv, byte, bins, ends);
     if (byte > 0)
     {
       const int numt = hrtree_max_num_threads();
-#     pragma omp parallel for schedule(dynamic,1) firstprivate(src, conv, byte) num_threads(numt)
-      for (int b = 0; b <= UINT8_MAX; ++b)
+      arch::parallel_for_dynamic(0, UINT8_MAX+1, 1, [&](int b)
       {
-        int n = ends[b] - bins[b];
+        I n = ends[b] - bins[b];
         if (32 >= n) insertion_sort_impl(src + bins[b], n, conv_less_cmp<CONV>(conv, byte - 1));
         else inplace_msd_radix_sort_impl(src + bins[b], n, conv, byte - 1);
-      }
+      }, numt);
     }
   }
 
@@ -112,8 +210,11 @@ namespace hrtree { namespace sorting { namespace detail {
 template < typename ZIt, typename CONV >
 inline bool parallel_radix_sort(ZIt first, ZIt last, ZIt buf, CONV conv, int bytes)
 {
-  int N = int(last - first);
-  return (1 < N) ? detail::parallel_radix_sort_impl(first, buf, N, conv, bytes) : false;
+  const std::ptrdiff_t N = last - first;
+  if (N <= 1) return false;
+  const int bits = std::min<int>(CHAR_BIT * bytes, detail::conv_key_bits<CONV>::value);
+  return (N <= INT_MAX) ? detail::parallel_radix_sort_impl(first, buf, int(N), conv, bits)
+                        : detail::parallel_radix_sort_impl(first, buf, N, conv, bits);
 }
 
 
@@ -135,10 +236,11 @@ inline bool parallel_radix_sort(ZIt first, ZIt last, ZIt buf)
 template < typename ZIt, typename CONV >
 inline void parallel_inplace_radix_sort(ZIt first, ZIt last, CONV conv)
 {  
-  int N = int(last - first);
+  const std::ptrdiff_t N = last - first;
   if (1 < N)
   {
     if (32 >= N) insertion_sort_impl(first, N, detail::conv_less_cmp<CONV>(conv, CONV::key_bytes-1));
+    else if (N <= INT_MAX) detail::parallel_inplace_msl_radix_sort_impl(first, int(N), conv, CONV::key_bytes-1);
     else detail::parallel_inplace_msl_radix_sort_impl(first, N, conv, CONV::key_bytes-1);
   }
 }
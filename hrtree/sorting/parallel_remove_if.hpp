@@ -0,0 +1,125 @@
+// hrtree/sorting/parallel_remove_if.hpp header file
+//
+// Part of the Hilbert Rtree library.
+// Copyright (c) 2000-2014 Hanno Hildenbrandt
+//
+// This software is provided "as is" without express or implied warranty,
+// and with no claim as to its suitability for any purpose.
+//
+// Stable, parallel remove_if for plain and zip iterators. The predicate
+// sees the head element. Every thread counts the survivors of its block,
+// prefix sums of the counts give the destination of each block.
+
+#ifndef HRTREE_SORTING_PARALLEL_REMOVE_IF_HPP
+#define HRTREE_SORTING_PARALLEL_REMOVE_IF_HPP
+
+#include <vector>
+#include <iterator>
+#include <numeric>
+#include <hrtree/config.hpp>
+#include <hrtree/arch/parallel.hpp>
+#include <hrtree/zip/zip.hpp>
+
+
+namespace hrtree { namespace sorting {
+
+namespace detail {
+
+  template <typename ZIt, typename Predicate>
+  inline std::ptrdiff_t count_survivors(ZIt first, std::ptrdiff_t i0, std::ptrdiff_t i1, Predicate& pred)
+  {
+    using namespace ::hrtree::zip;
+    std::ptrdiff_t n = 0;
+    for (std::ptrdiff_t i = i0; i < i1; ++i)
+    {
+      n += !pred(*head(first + i));
+    }
+    return n;
+  }
+
+  // ranges below this size per thread run serial
+  constexpr std::ptrdiff_t parallel_remove_if_min = 4096;
+
+}
+
+
+  //! Removes the elements satisfying pred(*head(it)) from [first, last),
+  //! the others keep their order. Returns the new end.
+  //! Blocks move their survivors within their own range and stash the
+  //! few that go in front of the block until all blocks are done reading.
+  template <typename ZIt, typename Predicate>
+  inline ZIt parallel_remove_if(ZIt first, ZIt last, Predicate pred)
+  {
+    using namespace ::hrtree::zip;
+    typedef typename std::iterator_traits<ZIt>::value_type T;
+
+    const std::ptrdiff_t N = last - first;
+    const int numt = hrtree_max_num_threads();
+    std::vector<std::ptrdiff_t> cnt(numt + 1, 0);
+    arch::parallel_region(numt, N >= numt * detail::parallel_remove_if_min, [&](arch::team& team)
+    {
+      const int tid = team.thread_num();
+      const auto block = team.static_block(std::ptrdiff_t(0), N);
+      cnt[tid + 1] = detail::count_survivors(first, block.first, block.second, pred);
+      team.barrier();
+      const std::ptrdiff_t ofs = std::accumulate(cnt.cbegin() + 1, cnt.cbegin() + tid + 1, std::ptrdiff_t(0));
+      std::vector<T> stash;
+      ZIt src(first);
+      std::ptrdiff_t dst = ofs;
+      for (std::ptrdiff_t i = block.first; i < block.second; ++i)
+      {
+        if (!pred(*head(first + i)))
+        {
+          if (dst < block.first) stash.emplace_back(std::move(*(first + i)));
+          else if (dst != i) iter_move(src, src, i, dst);
+          ++dst;
+        }
+      }
+      team.barrier();
+      for (size_t j = 0; j < stash.size(); ++j)
+      {
+        *(first + ofs + std::ptrdiff_t(j)) = std::move(stash[j]);
+      }
+    });
+    return first + std::accumulate(cnt.cbegin(), cnt.cend(), std::ptrdiff_t(0));
+  }
+
+
+  //! Copies the elements of [first, last) not satisfying pred(*head(it))
+  //! to out, in order. Returns the end of the output.
+  template <typename ZIt, typename OZIt, typename Predicate>
+  inline OZIt parallel_remove_copy_if(ZIt first, ZIt last, OZIt out, Predicate pred)
+  {
+    using namespace ::hrtree::zip;
+
+    const std::ptrdiff_t N = last - first;
+    const int numt = hrtree_max_num_threads();
+    std::vector<std::ptrdiff_t> cnt(numt + 1, 0);
+    arch::parallel_region(numt, N >= numt * detail::parallel_remove_if_min, [&](arch::team& team)
+    {
+      const int tid = team.thread_num();
+      const auto block = team.static_block(std::ptrdiff_t(0), N);
+      cnt[tid + 1] = detail::count_survivors(first, block.first, block.second, pred);
+      team.barrier();
+      std::ptrdiff_t dst = std::accumulate(cnt.cbegin() + 1, cnt.cbegin() + tid + 1, std::ptrdiff_t(0));
+      for (std::ptrdiff_t i = block.first; i < block.second; ++i)
+      {
+        if (!pred(*head(first + i)))
+        {
+          *(out + dst) = *(first + i);
+          ++dst;
+        }
+      }
+    });
+    return out + std::accumulate(cnt.cbegin(), cnt.cend(), std::ptrdiff_t(0));
+  }
+
+
+}
+
+using sorting::parallel_remove_if;
+using sorting::parallel_remove_copy_if;
+
+}
+
+#endif
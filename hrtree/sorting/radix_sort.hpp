@@ -9,7 +9,9 @@
 #ifndef HRTREE_SORTING_RADIX_SORT_HPP
 #define HRTREE_SORTING_RADIX_SORT_HPP
 
+#include <climits>
 #include <limits>
+#include <vector>
 #include <iterator>
 #include <algorithm>
 #include <cstdint>
@@ -35,10 +37,65 @@ namespace hrtree { namespace sorting { namespace detail {
   struct default_converter<T,  typename std::enable_if< T::is_isfc_key::value >::type > 
   {
     static const int key_bytes = T::key_bytes;
+    static const int key_bits = T::key_bits;
     const std::uint8_t* operator()(const T& x) const { return x.data(); }
   };
 
 
+  // Number of significant key bits. 
+  // Converters may announce key_bits, otherwise all key_bytes are significant.
+  template <typename CONV, typename Enable = void>
+  struct conv_key_bits
+  {
+    static const int value = CHAR_BIT * CONV::key_bytes;
+  };
+
+
+  template <typename CONV>
+  struct conv_key_bits<CONV, typename std::enable_if< (CONV::key_bits > 0) >::type>
+  {
+    static const int value = CONV::key_bits;
+  };
+
+
+  // Loads the (up to 64) lower key bits as an unsigned word.
+  template <typename CONV, typename T>
+  inline std::uint64_t load_key_word(const CONV& conv, const T& x)
+  {
+    static const int bytes = (CONV::key_bytes < 8) ? CONV::key_bytes : 8;
+    std::uint64_t w = 0;
+    memcpy(&w, conv(x), bytes);
+    return w;
+  }
+
+
+  // Digit plan for LSD radix sort: the minimal number of passes with
+  // digits not wider than max_bits, digit width spread evenly.
+  // hilbert<2,15>: 30 bits -> 3 passes of 10 bits instead of 4 byte passes.
+  struct radix_digits
+  {
+    static const int max_bits = 11;
+    static const int max_passes = (64 + max_bits - 1) / max_bits;
+
+    explicit radix_digits(int key_bits)
+    : passes((key_bits + max_bits - 1) / max_bits),
+      bits((key_bits + passes - 1) / passes),
+      bins(1 << bits),
+      mask((std::uint64_t(1) << bits) - 1),
+      key_mask((key_bits < 64) ? (std::uint64_t(1) << key_bits) - 1 : ~std::uint64_t(0))
+    {
+    }
+
+    int digit(std::uint64_t word, int pass) const { return int((word >> (pass * bits)) & mask); }
+
+    const int passes;
+    const int bits;
+    const int bins;
+    const std::uint64_t mask;
+    const std::uint64_t key_mask;
+  };
+
+
   template <typename CONV>
   struct conv_less_cmp
   {
@@ -58,33 +115,33 @@ namespace hrtree { namespace sorting { namespace detail {
   };
 
 
-  template <typename ZIt, typename CONV>
-  inline bool lsd_radix_sort_impl(ZIt src, ZIt buf, const int N, CONV conv, const int key_bytes)
+  template <typename ZIt, typename I, typename CONV>
+  inline bool lsd_radix_sort_bytes_impl(ZIt src, ZIt buf, const I N, CONV conv, const int key_bytes)
   {
-    int bins[UINT8_MAX+1];
+    I bins[UINT8_MAX+1];
     bool swaped = false;
     for (int byte = 0; byte < key_bytes; ++byte)
     {
-      memset(bins, 0, (UINT8_MAX+1)*sizeof(int));
+      memset(bins, 0, (UINT8_MAX+1)*sizeof(I));
       auto src0(zip::head(src));
-      for (int i = 0; i < N; ++i)
+      for (I i = 0; i < N; ++i)
       {
         std::uint8_t key = *(conv(*(src0 + i)) + byte);
         ++bins[key];
       }
       
       // Reduce prefix table
-      int cumsum = 0;
+      I cumsum = 0;
       for (int b = 0; b <= UINT8_MAX; ++b)
       {
-        const int count = bins[b];
+        const I count = bins[b];
         if (count == N) goto skip;
         bins[b] = cumsum;
         cumsum += count;
       }
 
       // Scatter
-      for (int i = 0; i<N; ++i)
+      for (I i = 0; i<N; ++i)
       {
         std::uint8_t key = *(conv(*(src0 + i)) + byte);
         zip::iter_move(src, buf, i, bins[key]++);
@@ -98,28 +155,82 @@ skip:
   }
 
 
-  template <typename ZIt, typename CONV>
-  inline int inplace_msd_radix_sort_prepare(ZIt src, const int N, CONV conv, int byte, int bins[UINT8_MAX+1], int ends[UINT8_MAX+1])
+  // LSD radix sort with digit width derived from the number of key bits.
+  // The histograms of all passes are gathered in a single read pass,
+  // passes with a singular histogram are skipped.
+  template <typename ZIt, typename I, typename CONV>
+  inline bool lsd_radix_sort_impl(ZIt src, ZIt buf, const I N, CONV conv, const int key_bits)
+  {
+    if (key_bits > 64) 
+    {
+      return lsd_radix_sort_bytes_impl(src, buf, N, conv, (key_bits + CHAR_BIT - 1) / CHAR_BIT);
+    }
+    const radix_digits rd(key_bits);
+    std::vector<I> hist(rd.passes * rd.bins, 0);
+    auto src0(zip::head(src));
+    for (I i = 0; i < N; ++i)
+    {
+      const std::uint64_t key = load_key_word(conv, *(src0 + i)) & rd.key_mask;
+      for (int pass = 0; pass < rd.passes; ++pass)
+      {
+        ++hist[pass * rd.bins + rd.digit(key, pass)];
+      }
+    }
+    bool swaped = false;
+    for (int pass = 0; pass < rd.passes; ++pass)
+    {
+      I* const bins = hist.data() + pass * rd.bins;
+
+      // Reduce prefix table
+      I cumsum = 0;
+      for (int b = 0; b < rd.bins; ++b)
+      {
+        const I count = bins[b];
+        if (count == N) goto skip;
+        bins[b] = cumsum;
+        cumsum += count;
+      }
+
+      // Scatter
+      {
+        auto src0(zip::head(src));
+        for (I i = 0; i < N; ++i)
+        {
+          const std::uint64_t key = load_key_word(conv, *(src0 + i)) & rd.key_mask;
+          zip::iter_move(src, buf, i, bins[rd.digit(key, pass)]++);
+        }
+      }
+      std::swap(src, buf);
+      swaped = !swaped;
+skip:
+      ;
+    }
+    return swaped;
+  }
+
+
+  template <typename ZIt, typename I, typename CONV>
+  inline int inplace_msd_radix_sort_prepare(ZIt src, const I N, CONV conv, int byte, I bins[UINT8_MAX+1], I ends[UINT8_MAX+1])
   {
     auto src0(zip::head(src));
     for (; byte >= 0; --byte)
     {
-      memset(bins, 0, (UINT8_MAX+1)*sizeof(int));
-      for (int i=0; i<N; ++i)
+      memset(bins, 0, (UINT8_MAX+1)*sizeof(I));
+      for (I i=0; i<N; ++i)
       {
         std::uint8_t key = *(conv(*(src0 + i)) + byte);
         ++bins[key];
       }
-      int cumsum = 0;
+      I cumsum = 0;
       int j = 0;
       for (int b=0; b<=UINT8_MAX; ++b) 
       {
-        int count = bins[b];
+        I count = bins[b];
         if (count == N) goto skip;
         bins[b] = ends[b] = cumsum;
         cumsum += count;
       }
-      for (int i=0; i<N; )
+      for (I i=0; i<N; )
       {
         std::uint8_t key = *(conv(*(src0 + i)) + byte);
         if (ends[key] != i)
@@ -144,18 +255,18 @@ skip :
   }
 
 
-  template <typename ZIt, typename CONV>
-  inline void inplace_msd_radix_sort_impl(ZIt src, const int N, CONV conv, int byte)
+  template <typename ZIt, typename I, typename CONV>
+  inline void inplace_msd_radix_sort_impl(ZIt src, const I N, CONV conv, int byte)
   {
-    int bins[UINT8_MAX+1];
-    int ends[UINT8_MAX+1];
+    I bins[UINT8_MAX+1];
+    I ends[UINT8_MAX+1];
 
     byte = inplace_msd_radix_sort_prepare(src, N, conv, byte, bins, ends);
     if (byte > 0)
     {
       for (int b = 0; b <= UINT8_MAX; ++b)
       {
-        int n = ends[b] - bins[b];
+        I n = ends[b] - bins[b];
         if (1 < n)
         {
           if (32 >= n) insertion_sort_impl(src + bins[b], n, conv_less_cmp<CONV>(conv, byte - 1));
@@ -169,11 +280,15 @@ skip :
 }  // namespace detail
 
   
+// Item counts beyond INT_MAX switch to 64-bit histograms.
 template < typename ZIt, typename CONV >
 inline bool radix_sort(ZIt first, ZIt last, ZIt buf, CONV conv)
 {
-  int N = int(last - first);
-  return (1 < N) ? detail::lsd_radix_sort_impl(first, buf, N, conv, CONV::key_bytes) : false;
+  const std::ptrdiff_t N = last - first;
+  if (N <= 1) return false;
+  const int bits = detail::conv_key_bits<CONV>::value;
+  return (N <= INT_MAX) ? detail::lsd_radix_sort_impl(first, buf, int(N), conv, bits)
+                        : detail::lsd_radix_sort_impl(first, buf, N, conv, bits);
 }
 
 
@@ -188,10 +303,11 @@ inline bool radix_sort(ZIt first, ZIt last, ZIt buf)
 template < typename ZIt, typename CONV >
 inline void inplace_radix_sort(ZIt first, ZIt last, CONV conv)
 {  
-  int N = int(last - first);
+  const std::ptrdiff_t N = last - first;
   if (1 < N)
   {
     if (32 >= N) insertion_sort_impl(first, N, detail::conv_less_cmp<CONV>(conv, CONV::key_bytes-1));
+    else if (N <= INT_MAX) detail::inplace_msd_radix_sort_impl(first, int(N), conv, CONV::key_bytes-1);
     else detail::inplace_msd_radix_sort_impl(first, N, conv, CONV::key_bytes-1);
   }
 }
@@ -0,0 +1,133 @@
+// hrtree/sorting/str_sort.hpp header file
+//
+// Part of the Hilbert Rtree library.
+// Copyright (c) 2000-2014 Hanno Hildenbrandt
+//
+// This software is provided "as is" without express or implied warranty,
+// and with no claim as to its suitability for any purpose.
+//
+// Sort-Tile-Recursive (STR) order for the implicit rtree layout.
+// Unlike curve orders, the tiles adapt to the data on every level,
+// which gives tighter nodes for elongated or mixed-size boxes.
+
+#ifndef HRTREE_SORTING_STR_SORT_HPP
+#define HRTREE_SORTING_STR_SORT_HPP
+
+#include <cmath>
+#include <array>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+#include <hrtree/config.hpp>
+#include <hrtree/adapt_point.hpp>
+#include <hrtree/arch/parallel.hpp>
+#include <hrtree/sorting/parallel_quick_sort.hpp>
+
+
+namespace hrtree { namespace sorting {
+
+namespace detail {
+
+
+  // Number of slices along the first of dims dimensions for n groups.
+  inline std::ptrdiff_t str_slices(std::ptrdiff_t n, int dims)
+  {
+    std::ptrdiff_t s = static_cast<std::ptrdiff_t>(std::ceil(std::pow(double(n), 1.0 / dims)));
+    while (s > 1 && std::pow(double(s - 1), dims) >= double(n)) --s;
+    return std::max<std::ptrdiff_t>(s, 1);
+  }
+
+
+  // Tiles [first, first + n) into groups of FANOUT consecutive elements:
+  // sorts along dimension d, cuts into slices of whole groups and
+  // tiles each slice along the remaining dimensions.
+  template <size_t FANOUT, int DIM, typename RaIt, typename Coor>
+  inline void str_tile(RaIt first, std::ptrdiff_t n, int d, const Coor& coor)
+  {
+    typedef typename std::iterator_traits<RaIt>::value_type T;
+    hrtree::parallel_quick_sort(first, first + n, [d, &coor](const T& a, const T& b) { return coor(a, d) < coor(b, d); });
+    if (d == DIM - 1) return;
+    const std::ptrdiff_t groups = (n + FANOUT - 1) / FANOUT;
+    const std::ptrdiff_t slices = str_slices(groups, DIM - d);
+    const std::ptrdiff_t slice_n = ((groups + slices - 1) / slices) * FANOUT;
+    const std::ptrdiff_t num_slices = (n + slice_n - 1) / slice_n;
+    arch::parallel_for(std::ptrdiff_t(0), num_slices, [&](std::ptrdiff_t s)
+    {
+      const std::ptrdiff_t i0 = s * slice_n;
+      str_tile<FANOUT, DIM>(first + i0, std::min(slice_n, n - i0), d + 1, coor);
+    }, hrtree_max_num_threads(), n > 100000);
+  }
+
+
+}
+
+
+  // Sorts [first, last) into Sort-Tile-Recursive order for an implicit
+  // rtree of the given fanouts: on every level l > 0, each run of
+  // LEAF_FANOUT * NODE_FANOUT^(l-1) elements starting at a multiple of
+  // it is a compact tile. point(x) returns the (adapted) point to sort
+  // element x by, e.g. the center of its bounding volume. buf shall
+  // hold last - first elements.
+  template <size_t LEAF_FANOUT, size_t NODE_FANOUT = LEAF_FANOUT, typename RaIt, typename PointFun>
+  inline void str_sort(RaIt first, RaIt last, RaIt buf, PointFun point)
+  {
+    typedef typename std::iterator_traits<RaIt>::value_type T;
+    typedef typename std::decay<decltype(point(*first))>::type point_type;
+    typedef traits::point_access<point_type> pa;
+    typedef typename traits::point_scalar<point_type>::type scalar;
+    static const int DIM = traits::point_dim<point_type>::value;
+
+    const std::ptrdiff_t N = last - first;
+    if (N <= std::ptrdiff_t(LEAF_FANOUT)) return;
+
+    // leaf level: tile the elements themselves
+    detail::str_tile<LEAF_FANOUT, DIM>(first, N, 0, [&point](const T& x, int d) { return pa::ptr(point(x))[d]; });
+
+    // upper levels: tile blocks of B elements, a partial block stays last
+    struct unit
+    {
+      std::array<scalar, DIM> c;
+      std::ptrdiff_t i;
+    };
+    std::vector<unit> units;
+    for (std::ptrdiff_t B = LEAF_FANOUT; (N + B - 1) / B > std::ptrdiff_t(NODE_FANOUT); B *= NODE_FANOUT)
+    {
+      const std::ptrdiff_t U = N / B;
+      units.resize(U);
+      arch::parallel_for(std::ptrdiff_t(0), U, [&](std::ptrdiff_t u)
+      {
+        // point may return by value, keep the point alive while it is read
+        const auto& p0 = point(*(first + u * B));
+        std::array<scalar, DIM> lo, hi;
+        for (int d = 0; d < DIM; ++d) lo[d] = hi[d] = pa::ptr(p0)[d];
+        for (std::ptrdiff_t j = 1; j < B; ++j)
+        {
+          const auto& pj = point(*(first + u * B + j));
+          const scalar* p = pa::ptr(pj);
+          for (int d = 0; d < DIM; ++d)
+          {
+            lo[d] = std::min(lo[d], p[d]);
+            hi[d] = std::max(hi[d], p[d]);
+          }
+        }
+        for (int d = 0; d < DIM; ++d) units[u].c[d] = scalar(0.5) * (lo[d] + hi[d]);
+        units[u].i = u;
+      });
+      detail::str_tile<NODE_FANOUT, DIM>(units.begin(), U, 0, [](const unit& x, int d) { return x.c[d]; });
+      arch::parallel_for(std::ptrdiff_t(0), U, [&](std::ptrdiff_t u)
+      {
+        std::copy(first + units[u].i * B, first + (units[u].i + 1) * B, buf + u * B);
+      });
+      std::copy(buf, buf + U * B, first);
+    }
+  }
+
+
+}
+
+using sorting::str_sort;
+
+}
+
+#endif
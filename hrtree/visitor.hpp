@@ -0,0 +1,52 @@
+// hrtree/visitor.hpp header file
+//
+// Part of the Hilbert Rtree library.
+// Copyright (c) 2000-2014 Hanno Hildenbrandt
+//
+// This software is provided "as is" without express or implied warranty,
+// and with no claim as to its suitability for any purpose.
+//
+// Query visitors either return void and see every hit, or return bool
+// where false stops the traversal. The choice is made at compile time,
+// void visitors pay nothing.
+
+#ifndef HRTREE_VISITOR_HPP_INCLUDED
+#define HRTREE_VISITOR_HPP_INCLUDED
+
+#include <utility>
+#include <type_traits>
+#include <hrtree/config.hpp>
+
+
+namespace hrtree {
+
+  namespace detail {
+
+    template <typename Fun, typename... Args>
+    inline bool invoke_visitor_aux(std::true_type, Fun& fun, Args&&... args)
+    {
+      fun(std::forward<Args>(args)...);
+      return true;
+    }
+
+    template <typename Fun, typename... Args>
+    inline bool invoke_visitor_aux(std::false_type, Fun& fun, Args&&... args)
+    {
+      return static_cast<bool>(fun(std::forward<Args>(args)...));
+    }
+
+  }
+
+
+  // Calls fun(args...), returns false if fun asks to stop.
+  template <typename Fun, typename... Args>
+  inline bool invoke_visitor(Fun& fun, Args&&... args)
+  {
+    typedef typename std::is_void<decltype(fun(std::forward<Args>(args)...))>::type returns_void;
+    return detail::invoke_visitor_aux(returns_void(), fun, std::forward<Args>(args)...);
+  }
+
+}
+
+
+#endif
@@ -58,13 +58,13 @@ namespace hrtree {
         template <typename ZIT>
         static auto deref(typename ZIT::type const& zit) -> typename ZIT::reference
         {
-          return ZIT::reference(*std::get<idx>(zit)...);
+          return typename ZIT::reference(*std::get<idx>(zit)...);
         }
 
         template <typename ZIT>
         static auto ptr(typename ZIT::type& zit) -> typename ZIT::pointer
         {
-          return ZIT::reference(std::addressof(*std::get<idx>(zit))...);
+          return typename ZIT::pointer(std::addressof(*std::get<idx>(zit))...);
         }
 
         template <typename ZIT>
@@ -0,0 +1,123 @@
+#ifndef PRED_PREY_AGENTS_HPP_INCLUDED
+#define PRED_PREY_AGENTS_HPP_INCLUDED
+
+// structure of arrays agent storage: x[], y[] and one attribute
+// per agent, each in its own huge page backed buffer.
+// agents_t::cbegin()/cend() is a zip-style view that can be passed
+// to basic_hrtree::build directly.
+//
+// all bugs are mine: Hanno 2021
+
+
+#include <vector>
+#include <iterator>
+#include <hrtree/memory/huge_page_allocator.hpp>
+#include <hrtree/memory/memory_footprint.hpp>
+#include <hrtree/sorting/parallel_remove_if.hpp>
+#include <torus/torus.hpp>
+
+
+namespace model {
+
+  template <typename Attr>
+  class agents_t
+  {
+    template <typename T>
+    using buffer_t = std::vector<T, hrtree::huge_page_allocator<T>>;
+
+  public:
+    using attr_type = Attr;
+
+    // view of agent index
+    struct const_reference
+    {
+      const float& x;
+      const float& y;
+      const Attr& attr;
+      size_t index;
+
+      torus::vec_t pos() const noexcept { return { x, y }; }
+    };
+
+    class const_iterator
+    {
+    public:
+      using iterator_category = std::random_access_iterator_tag;
+      using value_type = const_reference;
+      using difference_type = std::ptrdiff_t;
+      using pointer = void;
+      using reference = const_reference;
+
+      const_iterator() {}
+      const_iterator(const agents_t* agents, size_t i) : agents_(agents), i_(i) {}
+
+      reference operator*() const { return (*agents_)[i_]; }
+      reference operator[](difference_type n) const { return (*agents_)[i_ + n]; }
+
+      const_iterator& operator++() { ++i_; return *this; }
+      const_iterator& operator--() { --i_; return *this; }
+      const_iterator operator++(int) { auto tmp(*this); ++i_; return tmp; }
+      const_iterator operator--(int) { auto tmp(*this); --i_; return tmp; }
+      const_iterator& operator+=(difference_type n) { i_ += n; return *this; }
+      const_iterator& operator-=(difference_type n) { i_ -= n; return *this; }
+      const_iterator operator+(difference_type n) const { return const_iterator(agents_, i_ + n); }
+      const_iterator operator-(difference_type n) const { return const_iterator(agents_, i_ - n); }
+      difference_type operator-(const const_iterator& rhs) const { return difference_type(i_) - difference_type(rhs.i_); }
+
+      bool operator==(const const_iterator& rhs) const { return i_ == rhs.i_; }
+      bool operator!=(const const_iterator& rhs) const { return i_ != rhs.i_; }
+      bool operator<(const const_iterator& rhs) const { return i_ < rhs.i_; }
+
+    private:
+      const agents_t* agents_ = nullptr;
+      size_t i_ = 0;
+    };
+
+    agents_t() {}
+    explicit agents_t(size_t n) : x_(n), y_(n), attr_(n) {}
+
+    size_t size() const noexcept { return x_.size(); }
+    bool empty() const noexcept { return x_.empty(); }
+
+    const_reference operator[](size_t i) const { return { x_[i], y_[i], attr_[i], i }; }
+    const_iterator cbegin() const { return const_iterator(this, 0); }
+    const_iterator cend() const { return const_iterator(this, size()); }
+
+    torus::vec_t pos(size_t i) const noexcept { return { x_[i], y_[i] }; }
+    void pos(size_t i, const torus::vec_t& p) noexcept { x_[i] = p[0]; y_[i] = p[1]; }
+
+    float* x() noexcept { return x_.data(); }
+    float* y() noexcept { return y_.data(); }
+    Attr* attr() noexcept { return attr_.data(); }
+    const float* x() const noexcept { return x_.data(); }
+    const float* y() const noexcept { return y_.data(); }
+    const Attr* attr() const noexcept { return attr_.data(); }
+
+    // removes the agents with pred(attr), the others keep their order.
+    template <typename Pred>
+    void remove_if(Pred pred)
+    {
+      auto first = hrtree::zip::make_zip(attr_.begin(), x_.begin(), y_.begin());
+      auto last = hrtree::parallel_remove_if(first, first + size(), pred);
+      const size_t n = size_t(last - first);
+      x_.resize(n);
+      y_.resize(n);
+      attr_.resize(n);
+    }
+
+    hrtree::memory_footprint memory_usage() const
+    {
+      return hrtree::memory::container_footprint(x_)
+        + hrtree::memory::container_footprint(y_)
+        + hrtree::memory::container_footprint(attr_);
+    }
+
+  private:
+    buffer_t<float> x_;
+    buffer_t<float> y_;
+    buffer_t<Attr> attr_;
+  };
+
+}
+
+#endif
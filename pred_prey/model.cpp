@@ -1,7 +1,9 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <algorithm>
+#include <hrtree/arch/parallel.hpp>
 #include "model.hpp"
+#include "random_walk.hpp"
 
 
 using namespace torus;
@@ -14,20 +16,19 @@ namespace model {
 
 
   Simulation::Simulation(const Param& param) :
-    grid_(param.GS, 0.0f),
+    grid_(param.GS, 0.0f, param.grow_back, 1.0f),
     prey_(param.N_prey),
     pred_(param.N_pred),
+    pred_sr_(param.pred_sr * grid_.pixel_radii()),
     param_(param)
   {
     auto& reng = greng;
     auto pdist = std::uniform_real_distribution<float>(0.0f, 1.0f);
-    for (auto& prey : prey_) {
-      prey.pos = { pdist(reng), pdist(reng) };
+    for (size_t i = 0; i < prey_.size(); ++i) {
+      prey_.pos(i, { pdist(reng), pdist(reng) });
     }
-
-    const auto psr = param.pred_sr * grid_.pixel_radii();   // search radius
-    for (auto& pred : pred_) {
-      pred.pos_sr = { { pdist(reng), pdist(reng) }, psr };
+    for (size_t i = 0; i < pred_.size(); ++i) {
+      pred_.pos(i, { pdist(reng), pdist(reng) });
     }
   }
 
@@ -44,58 +45,68 @@ namespace model {
 
   void Simulation::single_step()
   {
-    // grow back
-    for (auto& c : grid_) {
-      c = std::min(1.0f, c + param_.grow_back);
-    }
+    // grow back, cells catch up when grazed
+    grid_.advance();
 
     // move our critters around on the torus
     random_walks();
 
     // build the search trees
-    prey_tree_.build(prey_.cbegin(), prey_.cend(), [](auto& prey) { return aabb_t{ prey.pos, {0,0} }; });
-    pred_tree_.build(pred_.cbegin(), pred_.cend(), [](auto& pred) { return pred.pos_sr; });
+    prey_tree_.build(prey_.cbegin(), prey_.cend(), [](const auto& prey) { return aabb_t{ prey.pos(), {0,0} }; });
+    pred_tree_.build(pred_.cbegin(), pred_.cend(), [psr = pred_sr_](const auto& pred) { return aabb_t{ pred.pos(), psr }; }, [](const auto& pred) {
+      return PredHit{ pred.pos(), static_cast<int32_t>(pred.index) };
+    });
 
     graze();
     hunt();
+    peak_.sample(memory_usage());
 
     // remove dead prey
-    prey_.erase(
-      std::partition(prey_.begin(), prey_.end(), [](const auto& prey) { return prey.uptake >= 0.0; }),
-      prey_.end()
-    );
+    prey_.remove_if([](double uptake) { return uptake < 0.0; });
+  }
+
+
+  hrtree::memory_footprint Simulation::memory_usage() const
+  {
+    return grid_.memory_usage()
+      + prey_.memory_usage()
+      + pred_.memory_usage()
+      + prey_tree_.memory_usage()
+      + pred_tree_.memory_usage();
   }
 
 
   void Simulation::random_walks()
   {
-    auto& reng = greng;
-    auto adist = std::uniform_real_distribution<float>(0.f, static_cast<float>(2.0 * M_PI));
-    auto sdist = [&]() {
-      const auto a = adist(reng);
-      return vec_t{ std::cos(a), std::sin(a) };
+    // every agent draws from its own stream (key, index, step)
+    static constexpr size_t B = 4096;
+    auto walk = [t = step_](auto& agents, uint32_t key, float len) {
+      const size_t N = agents.size();
+      hrtree::arch::parallel_for(size_t(0), (N + B - 1) / B, [&](size_t b) {
+        const size_t i0 = b * B;
+        random_steps(agents.x() + i0, agents.y() + i0, std::min(B, N - i0), static_cast<uint32_t>(i0), t, key, len);
+      }, hrtree_max_num_threads(), N > 4 * B);
     };
-    for (auto& prey : prey_) {
-      prey.pos = wrap(prey.pos + param_.prey_step * sdist());
-    }
-    for (auto& pred : pred_) {
-      pred.pos_sr.center = wrap(pred.pos_sr.center + param_.pred_step * sdist());
-    }
+    walk(prey_, 2 * param_.seed, param_.prey_step);
+    walk(pred_, 2 * param_.seed + 1, param_.pred_step);
+    ++step_;
   }
 
 
   void Simulation::graze()
   {
     // fair share between prey on same cell
+    double* uptake = prey_.attr();
     for (size_t i = 0; i < prey_.size(); ++i) {
       int on_cell = 0;          // # prey on cell
-      prey_tree_.query(grid_.pixel(prey_[i].pos), [&](size_t /* j */) {
+      const auto pos = prey_.pos(i);
+      prey_tree_.query(grid_.pixel(pos), [&](size_t /* j */) {
         ++on_cell;    // including 'i'
         });
-      prey_[i].uptake += grid_(prey_[i].pos) / static_cast<double>(on_cell);
+      uptake[i] += grid_(pos) / static_cast<double>(on_cell);
     }
     for (size_t i = 0; i < prey_.size(); ++i) {
-      grid_(prey_[i].pos) = 0.0f;
+      grid_(prey_.pos(i)) = 0.0f;
     }
   }
 
@@ -103,20 +114,21 @@ namespace model {
   void Simulation::hunt()
   {
     // closest predator wins 
+    double* uptake = prey_.attr();
     for (size_t i = 0; i < prey_.size(); ++i) {
       float min_dd = param_.pred_sr * param_.pred_sr;  // min distance2 so far
       size_t jpred = -1;
-      const auto pos = prey_[i].pos;
-      pred_tree_.query({ pos, {0,0} }, [&](size_t j) {
-        const auto dd = distance2(pos, pred_[j].pos_sr.center);
+      const auto pos = prey_.pos(i);
+      pred_tree_.query_payload({ pos, {0,0} }, [&](const PredHit& hit) {
+        const auto dd = distance2(pos, hit.pos);
         if (dd < min_dd) {
           min_dd = dd;
-          jpred = j;
-          prey_[i].uptake = -1.0;   // doomed
+          jpred = hit.idx;
+          uptake[i] = -1.0;   // doomed
         }
       });
       if (jpred != -1) {
-        ++pred_[jpred].catches;
+        ++pred_.attr()[jpred];
       }
     }
   }
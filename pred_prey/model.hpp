@@ -5,6 +5,7 @@
 #include <torus/torus.hpp>
 #include <torus/torus_grid.hpp>
 #include <torus/torus_hrtree.hpp>
+#include "agents.hpp"
 
 namespace model {
 
@@ -22,43 +23,53 @@ namespace model {
     float prey_step = 1.0f;   // step length [grid cells] 
     float pred_step = 1.5f;   // step length [grid cells] 
     float pred_sr = 0.5;     // search radius [grid cells]
+    uint32_t seed = 0;        // random walks
   };
 
 
-  struct Prey
-  {
-    torus::vec_t pos = { 0,0 };
-    double uptake = 0.0;      // resource uptake; -1.0: dead
-  };
+  // uptake: resource uptake; -1.0: dead
+  using prey_t = agents_t<double>;
 
+  // catches; the search radius is the same for all
+  using pred_t = agents_t<int>;
 
-  struct Pred
+
+  // stored with the leaves of the predator tree
+  struct PredHit
   {
-    torus::aabb_t pos_sr = { {0,0,},{0,0} };    // position & search-radius
-    int catches = 0;
+    torus::vec_t pos;
+    int32_t idx;
   };
 
 
   class Simulation
   {
     using search_tree_t = torus::hrtree_t;
+    using pred_tree_t = torus::basic_hrtree<int32_t, torus::hilbert_key_t, PredHit>;
 
   public:
     Simulation(const Param& param);
     size_t run();
 
+    // current and peak (sampled once per step) heap memory
+    hrtree::memory_footprint memory_usage() const;
+    const hrtree::peak_memory& peak_memory_usage() const { return peak_; }
+
   private:
     void single_step();
     void random_walks();
     void graze();
     void hunt();
 
-    torus::grid_t<float> grid_;
-    std::vector<Prey> prey_;
-    std::vector<Pred> pred_;
+    torus::regrowth_grid_t<float> grid_;
+    prey_t prey_;
+    pred_t pred_;
+    torus::vec_t pred_sr_;    // search radii
     search_tree_t prey_tree_;
-    search_tree_t pred_tree_;
+    pred_tree_t pred_tree_;
     Param param_;
+    hrtree::peak_memory peak_;
+    uint32_t step_ = 0;
   };
 
 }
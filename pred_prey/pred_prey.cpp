@@ -12,5 +12,9 @@ int main()
   const auto t = sim.run();
   std::cout << "prey went extinct after " << t << " steps (";
   std::cout << watch.elapsed_seconds() << " s)\n";
+  const auto& peak = sim.peak_memory_usage().at_peak();
+  std::cout << "peak memory " << peak.total() / 1024 << " kB (tree levels " << peak.levels / 1024;
+  std::cout << " kB, permutation " << peak.permutation / 1024 << " kB, sort scratch " << peak.sort_scratch / 1024;
+  std::cout << " kB, slack " << peak.slack / 1024 << " kB, other " << peak.other / 1024 << " kB)\n";
   return 0;
 }
@@ -0,0 +1,182 @@
+#ifndef PRED_PREY_RANDOM_WALK_HPP_INCLUDED
+#define PRED_PREY_RANDOM_WALK_HPP_INCLUDED
+
+// counter-based random walks: the step of agent id at time t depends
+// on (key, id, t) only. Thus, the result doesn't depend on the order
+// or the number of threads the agents are moved in.
+//
+// all bugs are mine: Hanno 2021
+
+
+#include <cstdint>
+#include <cmath>
+#include <hrtree/config.hpp>
+#if defined(HRTREE_HAS_AVX2)
+  #include <immintrin.h>
+#endif
+
+// The steps shall not depend on the compiler flags: a * b + c must not
+// be contracted into a fused multiply-add, which rounds differently.
+// GCC ignores FP_CONTRACT and contracts across statements by default.
+#if defined(__clang__)
+  #define PRED_PREY_FP_CONTRACT_OFF _Pragma("STDC FP_CONTRACT OFF")
+#else
+  #define PRED_PREY_FP_CONTRACT_OFF
+  #if defined(__GNUC__)
+    #pragma GCC push_options
+    #pragma GCC optimize("fp-contract=off")
+  #endif
+#endif
+
+
+namespace model {
+
+  namespace detail {
+
+    constexpr uint32_t philox_m = 0xD256D193;
+    constexpr uint32_t philox_w = 0x9E3779B9;
+    constexpr int philox_rounds = 10;
+
+    // sincos on [-pi/2, pi/2] quadrants, Cephes polynomials
+    constexpr float pio2_1 = 1.5703125f;
+    constexpr float pio2_2 = 4.837512969970703125e-4f;
+    constexpr float pio2_3 = 7.54978995489188216e-8f;
+    constexpr float two_opi = 0.636619772367581343f;
+    constexpr float two_pi = 6.28318530717958648f;
+    constexpr float s1 = -1.6666654611e-1f, s2 = 8.3321608736e-3f, s3 = -1.9515295891e-4f;
+    constexpr float c1 = 4.166664568298827e-2f, c2 = -1.388731625493765e-3f, c3 = 2.443315711809948e-5f;
+
+  }
+
+
+  // Philox2x32-10, first word of the block (c0, c1) under key
+  inline uint32_t philox(uint32_t c0, uint32_t c1, uint32_t key) noexcept
+  {
+    for (int r = 0; r < detail::philox_rounds; ++r, key += detail::philox_w) {
+      const uint64_t p = uint64_t(detail::philox_m) * c0;
+      c0 = uint32_t(p >> 32) ^ key ^ c1;
+      c1 = uint32_t(p);
+    }
+    return c0;
+  }
+
+
+  // uniform in [-pi, pi)
+  inline float random_angle(uint32_t x) noexcept
+  {
+    return (float(x >> 8) * (1.f / 16777216.f) - 0.5f) * detail::two_pi;
+  }
+
+
+  // sin and cos of a, |a| <= pi
+  inline void sincos(float a, float& s, float& c) noexcept
+  {
+    PRED_PREY_FP_CONTRACT_OFF
+    using namespace detail;
+    const float j = std::nearbyint(a * two_opi);
+    const float r = ((a - j * pio2_1) - j * pio2_2) - j * pio2_3;
+    const float r2 = r * r;
+    const float ps = r + r * r2 * (s1 + r2 * (s2 + r2 * s3));
+    const float pc = (1.f - 0.5f * r2) + r2 * r2 * (c1 + r2 * (c2 + r2 * c3));
+    const int q = int(j) & 3;
+    s = (q & 1) ? pc : ps;
+    c = (q & 1) ? ps : pc;
+    if (q == 1 || q == 2) c = -c;
+    if (q & 2) s = -s;
+  }
+
+
+#if defined(HRTREE_HAS_AVX2)
+
+  // eight blocks at once
+  inline __m256i philox(__m256i c0, __m256i c1, uint32_t key) noexcept
+  {
+    const __m256i m = _mm256_set1_epi32(int(detail::philox_m));
+    for (int r = 0; r < detail::philox_rounds; ++r, key += detail::philox_w) {
+      const __m256i lo = _mm256_mullo_epi32(c0, m);
+      const __m256i pe = _mm256_mul_epu32(c0, m);                           // lanes 0, 2, 4, 6
+      const __m256i po = _mm256_mul_epu32(_mm256_srli_epi64(c0, 32), m);   // lanes 1, 3, 5, 7
+      const __m256i hi = _mm256_blend_epi32(_mm256_srli_epi64(pe, 32), po, 0xAA);
+      c0 = _mm256_xor_si256(_mm256_xor_si256(hi, _mm256_set1_epi32(int(key))), c1);
+      c1 = lo;
+    }
+    return c0;
+  }
+
+
+  inline __m256 random_angle(__m256i x) noexcept
+  {
+    const __m256 u = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(x, 8)), _mm256_set1_ps(1.f / 16777216.f));
+    return _mm256_mul_ps(_mm256_sub_ps(u, _mm256_set1_ps(0.5f)), _mm256_set1_ps(detail::two_pi));
+  }
+
+
+  inline void sincos(__m256 a, __m256& s, __m256& c) noexcept
+  {
+    PRED_PREY_FP_CONTRACT_OFF
+    using namespace detail;
+    const __m256 j = _mm256_round_ps(_mm256_mul_ps(a, _mm256_set1_ps(two_opi)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_sub_ps(a, _mm256_mul_ps(j, _mm256_set1_ps(pio2_1)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(j, _mm256_set1_ps(pio2_2)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(j, _mm256_set1_ps(pio2_3)));
+    const __m256 r2 = _mm256_mul_ps(r, r);
+    __m256 ps = _mm256_add_ps(_mm256_set1_ps(s2), _mm256_mul_ps(r2, _mm256_set1_ps(s3)));
+    ps = _mm256_add_ps(_mm256_set1_ps(s1), _mm256_mul_ps(r2, ps));
+    ps = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, r2), ps));
+    __m256 pc = _mm256_add_ps(_mm256_set1_ps(c2), _mm256_mul_ps(r2, _mm256_set1_ps(c3)));
+    pc = _mm256_add_ps(_mm256_set1_ps(c1), _mm256_mul_ps(r2, pc));
+    pc = _mm256_add_ps(_mm256_sub_ps(_mm256_set1_ps(1.f), _mm256_mul_ps(_mm256_set1_ps(0.5f), r2)), _mm256_mul_ps(_mm256_mul_ps(r2, r2), pc));
+    // quadrant: swap on odd, negate sin on 2, 3 and cos on 1, 2
+    const __m256i q = _mm256_cvtps_epi32(j);
+    const __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+    const __m256i sneg = _mm256_slli_epi32(_mm256_srli_epi32(q, 1), 31);
+    const __m256i cneg = _mm256_slli_epi32(_mm256_srli_epi32(_mm256_add_epi32(q, _mm256_set1_epi32(1)), 1), 31);
+    s = _mm256_xor_ps(_mm256_blendv_ps(ps, pc, swap), _mm256_castsi256_ps(sneg));
+    c = _mm256_xor_ps(_mm256_blendv_ps(pc, ps, swap), _mm256_castsi256_ps(cneg));
+  }
+
+
+  // fractional part, see torus::wrap
+  inline __m256 wrap(__m256 x) noexcept
+  {
+    return _mm256_sub_ps(x, _mm256_floor_ps(x));
+  }
+
+#endif
+
+
+  // moves the agents id0, id0 + 1, ... id0 + n - 1 at (x[i], y[i])
+  // by len into a random direction and wraps them back onto the torus.
+  inline void random_steps(float* x, float* y, size_t n, uint32_t id0, uint32_t t, uint32_t key, float len) noexcept
+  {
+    PRED_PREY_FP_CONTRACT_OFF
+    size_t i = 0;
+#if defined(HRTREE_HAS_AVX2)
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 vlen = _mm256_set1_ps(len);
+    for (; i + 8 <= n; i += 8) {
+      const __m256i id = _mm256_add_epi32(_mm256_set1_epi32(int(id0 + uint32_t(i))), lane);
+      __m256 s, c;
+      sincos(random_angle(philox(id, _mm256_set1_epi32(int(t)), key)), s, c);
+      _mm256_storeu_ps(x + i, wrap(_mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_mul_ps(vlen, c))));
+      _mm256_storeu_ps(y + i, wrap(_mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(vlen, s))));
+    }
+#endif
+    for (; i < n; ++i) {
+      float s, c;
+      sincos(random_angle(philox(id0 + uint32_t(i), t, key)), s, c);
+      const float xi = x[i] + len * c;
+      const float yi = y[i] + len * s;
+      x[i] = xi - std::floor(xi);
+      y[i] = yi - std::floor(yi);
+    }
+  }
+
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+  #pragma GCC pop_options
+#endif
+#undef PRED_PREY_FP_CONTRACT_OFF
+
+#endif
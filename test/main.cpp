@@ -1,9 +1,14 @@
 #include <iostream>
 #include <random>
 #include <algorithm>
+#include <cstring>
+#include <cstdlib>
 #include <torus/torus.hpp>
 #include <torus/torus_hrtree.hpp>
+#include <torus/torus_compact_hrtree.hpp>
 #include <torus/torus_grid.hpp>
+#include <torus/torus_shapes.hpp>
+#include <pred_prey/random_walk.hpp>
 #include <game_watches.hpp>
 
 
@@ -12,13 +17,17 @@ using namespace torus;
 
 constexpr size_t N = 1'000;
 constexpr size_t G = 10;
+constexpr size_t NL = 2'000'000;   // tree much larger than L2
+constexpr size_t QL = 100'000;     // queries per round into the large tree
+constexpr size_t NC = 200'000;     // items in the curve comparison
+constexpr size_t NK = 64;          // clusters in the clustered data set
 
 
 auto reng = std::default_random_engine(0x12345678);
 
 
 template <typename SearchObj>
-void test(std::vector<aabb_t>& pop)
+void test(std::vector<aabb_t>& pop, size_t Q = N)
 {
   game_watches::stop_watch bwatch{};
   game_watches::stop_watch qwatch{};
@@ -34,8 +43,8 @@ void test(std::vector<aabb_t>& pop)
     stree.build(pop.cbegin(), pop.cend(), [](const auto& bbox) { return bbox; });
     bwatch.stop();
     qwatch.start();
-    for (size_t i = 0; i < N; ++i) {
-      stree.query(pop[i], [&](auto idx) { ++overlaps; });
+    for (size_t i = 0; i < Q; ++i) {
+      stree.query(pop[(i * 7919) % pop.size()], [&](auto idx) { ++overlaps; });
     }
     qwatch.stop();
   }
@@ -45,8 +54,520 @@ void test(std::vector<aabb_t>& pop)
 }
 
 
+template <typename Tree>
+void memory(const std::vector<aabb_t>& pop)
+{
+  Tree stree;
+  stree.build(pop.cbegin(), pop.cend(), [](const auto& bbox) { return bbox; });
+  const auto mf = stree.memory_usage();
+  std::cout << mf.levels / pop.size() << " bytes per item in tree and boxes, " << mf.total() / pop.size() << " total\n";
+}
+
+
+// adaptive_sort vs. std::sort on sorted keys with some disorder
+void resort(size_t n)
+{
+  std::vector<uint64_t> sorted(n);
+  for (size_t i = 0; i < n; ++i) sorted[i] = 4 * i;
+  auto idist = std::uniform_int_distribution<size_t>(0, n - 1);
+  auto run = [&](const char* name, auto disorder) {
+    auto keys = sorted;
+    for (size_t k = 0; k < n / 32; ++k) disorder(keys, idist(reng));
+    auto ref = keys;
+    std::vector<uint64_t> buf(n);
+    game_watches::stop_watch awatch{};
+    game_watches::stop_watch swatch{};
+    awatch.start();
+    const bool adapted = hrtree::sorting::adaptive_sorted == hrtree::adaptive_sort(keys.begin(), keys.end(), buf.begin());
+    awatch.stop();
+    swatch.start();
+    std::sort(ref.begin(), ref.end());
+    swatch.stop();
+    std::cout << name << ": "
+              << awatch.elapsed<std::chrono::microseconds>().count() << " us adaptive, "
+              << swatch.elapsed<std::chrono::microseconds>().count() << " us std::sort, "
+              << ((adapted && keys == ref) ? "ok\n" : (adapted ? "FAILED\n" : "fallback\n"));
+  };
+  run("neighbor swaps", [](auto& keys, size_t i) { if (i + 1 < keys.size()) std::swap(keys[i], keys[i + 1]); });
+  run("short moves", [](auto& keys, size_t i) { keys[i] += 4 * 7 + 1; });
+  run("scattered swaps", [n](auto& keys, size_t i) { std::swap(keys[i], keys[(i * 7919) % n]); });
+  run("far forward jumps", [n](auto& keys, size_t i) { keys[i - i % 32] += 2 * n + 1; });
+}
+
+
+// Gaussian blobs around NK random centers
+std::vector<aabb_t> clustered(size_t n, float radius)
+{
+  std::vector<vec_t> centers;
+  auto pdist = std::uniform_real_distribution<float>(0.0f, 1.0f);
+  for (size_t k = 0; k < NK; ++k) {
+    centers.push_back({ pdist(reng), pdist(reng) });
+  }
+  auto ndist = std::normal_distribution<float>(0.0f, 0.02f);
+  std::vector<aabb_t> pop;
+  for (size_t i = 0; i < n; ++i) {
+    const auto& c = centers[i % NK];
+    pop.push_back({ wrap(c + vec_t{ ndist(reng), ndist(reng) }), {radius, radius} });
+  }
+  return pop;
+}
+
+
+// build vs. query cost of the space filling curves
+void curves(std::vector<aabb_t>& pop, size_t Q)
+{
+  std::cout << "Hilbert\n";
+  test<basic_hrtree<int32_t, hilbert_key_t>>(pop, Q);
+  std::cout << "Morton\n";
+  test<basic_hrtree<int32_t, morton_key_t>>(pop, Q);
+  std::cout << "Gray\n";
+  test<basic_hrtree<int32_t, gray_key_t>>(pop, Q);
+}
+
+
+// curve vs. STR vs. top-down leaf ordering
+template <typename Tree, leaf_ordering O>
+struct ordered : Tree
+{
+  ordered() { this->ordering(O); }
+};
+
+
+void orderings(std::vector<aabb_t>& pop, size_t Q)
+{
+  std::cout << "curve\n";
+  test<ordered<hrtree_t, leaf_ordering::curve>>(pop, Q);
+  std::cout << "STR\n";
+  test<ordered<hrtree_t, leaf_ordering::str>>(pop, Q);
+  std::cout << "OMT\n";
+  test<ordered<hrtree_t, leaf_ordering::omt>>(pop, Q);
+}
+
+
+// tree vs. curve-range query over the query box size
+void query_modes(const std::vector<aabb_t>& pop, size_t Q)
+{
+  hrtree_t stree;
+  stree.build(pop.cbegin(), pop.cend(), [](const auto& bbox) { return bbox; });
+  for (float r : { 0.0005f, 0.002f, 0.01f, 0.05f }) {
+    game_watches::stop_watch twatch{};
+    game_watches::stop_watch cwatch{};
+    size_t toverlaps = 0, coverlaps = 0;
+    twatch.start();
+    for (size_t i = 0; i < Q; ++i) {
+      stree.query({ pop[(i * 7919) % pop.size()].center, {r, r} }, [&](auto /*idx*/) { ++toverlaps; });
+    }
+    twatch.stop();
+    cwatch.start();
+    for (size_t i = 0; i < Q; ++i) {
+      stree.query_curve({ pop[(i * 7919) % pop.size()].center, {r, r} }, [&](auto /*idx*/) { ++coverlaps; });
+    }
+    cwatch.stop();
+    std::cout << "radius " << r << ": "
+              << twatch.elapsed<std::chrono::microseconds>().count() << " us tree, "
+              << cwatch.elapsed<std::chrono::microseconds>().count() << " us curve, "
+              << toverlaps << " / " << coverlaps << " overlaps\n";
+  }
+}
+
+
+// indices of the items accepted by accept(item)
+template <typename Accept>
+std::vector<size_t> brute_force(const std::vector<aabb_t>& pop, Accept accept)
+{
+  std::vector<size_t> ref;
+  for (size_t j = 0; j < pop.size(); ++j) {
+    if (accept(pop[j])) ref.push_back(j);
+  }
+  return ref;
+}
+
+
+// Node boxes are rounded, a tree may miss items that touch the query
+// within a few ulps. A result passes if it contains the items accepted
+// by a slightly shrunk query and nothing beyond the exact one.
+bool bracketed(std::vector<size_t> found, const std::vector<size_t>& strict, const std::vector<size_t>& loose)
+{
+  std::sort(found.begin(), found.end());
+  return std::includes(found.begin(), found.end(), strict.begin(), strict.end())
+      && std::includes(loose.begin(), loose.end(), found.begin(), found.end());
+}
+
+
+constexpr float tol = 1e-5f;    // shrinks the queries of the strict references
+
+
+// payload query against brute force over the items.
+// Returns the number of queries with wrong hits.
+size_t payloads(const std::vector<aabb_t>& pop, size_t Q, float r)
+{
+  struct hit_t { vec_t center; int32_t idx; };
+  basic_hrtree<int32_t, hilbert_key_t, hit_t> stree;
+  stree.build(pop.cbegin(), pop.cend(), [](const auto& bbox) { return bbox; },
+              [&pop](const aabb_t& bbox) { return hit_t{ bbox.center, int32_t(&bbox - pop.data()) }; });
+  size_t failed = 0;
+  std::vector<size_t> hits;
+  for (size_t i = 0; i < Q; ++i) {
+    const aabb_t q{ pop[(i * 7919) % pop.size()].center, {r, r} };
+    const aabb_t qs{ q.center, {r - tol, r - tol} };
+    hits.clear();
+    bool payload = true;
+    stree.query_payload(q, [&](const hit_t& hit) {
+      hits.push_back(size_t(hit.idx));
+      payload = payload && hit.center == pop[hit.idx].center;
+    });
+    const auto strict = brute_force(pop, [&](const aabb_t& item) { return intersects(qs, item); });
+    const auto loose = brute_force(pop, [&](const aabb_t& item) { return intersects(q, item); });
+    failed += !payload || !bracketed(hits, strict, loose);
+  }
+  std::cout << "radius " << r << ": " << Q << " queries, " << failed << " failed\n";
+  return failed;
+}
+
+
+// full query vs. early exit. Returns the number of queries whose
+// any / count_upto disagree with brute force.
+template <typename Tree>
+size_t early_exit(const std::vector<aabb_t>& pop, size_t Q, float r)
+{
+  Tree stree;
+  stree.build(pop.cbegin(), pop.cend(), [](const auto& bbox) { return bbox; });
+  game_watches::stop_watch qwatch{};
+  game_watches::stop_watch awatch{};
+  game_watches::stop_watch cwatch{};
+  size_t overlaps = 0, anys = 0, counts = 0;
+  qwatch.start();
+  for (size_t i = 0; i < Q; ++i) {
+    stree.query({ pop[(i * 7919) % pop.size()].center, {r, r} }, [&](auto /*idx*/) { ++overlaps; });
+  }
+  qwatch.stop();
+  awatch.start();
+  for (size_t i = 0; i < Q; ++i) {
+    anys += stree.any({ pop[(i * 7919) % pop.size()].center, {r, r} });
+  }
+  awatch.stop();
+  cwatch.start();
+  for (size_t i = 0; i < Q; ++i) {
+    counts += stree.count_upto({ pop[(i * 7919) % pop.size()].center, {r, r} }, 4);
+  }
+  cwatch.stop();
+  size_t failed = 0;
+  for (size_t i = 0; i < Q; i += 97) {
+    // off-center queries, some of them empty
+    const aabb_t q{ wrap(pop[(i * 7919) % pop.size()].center + vec_t{ 3 * r, r }), {r, r} };
+    const aabb_t qs{ q.center, {r - tol, r - tol} };
+    const size_t strict = brute_force(pop, [&](const aabb_t& item) { return intersects(qs, item); }).size();
+    const size_t loose = brute_force(pop, [&](const aabb_t& item) { return intersects(q, item); }).size();
+    const bool any = stree.any(q);
+    const size_t count = stree.count_upto(q, 4);
+    failed += (strict && !any) || (!loose && any);
+    failed += count < std::min<size_t>(strict, 4) || count > std::min<size_t>(loose, 4);
+    failed += stree.count_upto(q, 0) != 0;
+  }
+  std::cout << "radius " << r << ": "
+            << qwatch.elapsed<std::chrono::microseconds>().count() << " us query (" << overlaps << "), "
+            << awatch.elapsed<std::chrono::microseconds>().count() << " us any (" << anys << "), "
+            << cwatch.elapsed<std::chrono::microseconds>().count() << " us count_upto 4 (" << counts << "), "
+            << failed << " failed\n";
+  return failed;
+}
+
+
+// raycast vs. box cover of the ray, filtered by the exact test.
+// Returns the number of disagreements with brute force.
+size_t rays(const std::vector<aabb_t>& pop, size_t Q, float len)
+{
+  hrtree_t stree;
+  stree.build(pop.cbegin(), pop.cend(), [](const auto& bbox) { return bbox; });
+  game_watches::stop_watch rwatch{};
+  game_watches::stop_watch fwatch{};
+  game_watches::stop_watch bwatch{};
+  size_t rhits = 0, fhits = 0, bhits = 0;
+  auto ray = [&](size_t i, vec_t& o, vec_t& d) {
+    o = pop[(i * 7919) % pop.size()].center;
+    const float a = 6.2831853f * float(i) / float(Q);
+    d = { std::cos(a), std::sin(a) };
+  };
+  rwatch.start();
+  for (size_t i = 0; i < Q; ++i) {
+    vec_t o, d; ray(i, o, d);
+    stree.raycast(o, d, len, [&](auto /*idx*/, float /*t*/) { ++rhits; });
+  }
+  rwatch.stop();
+  fwatch.start();
+  for (size_t i = 0; i < Q; ++i) {
+    vec_t o, d; ray(i, o, d);
+    stree.raycast(o, d, len, [&](auto /*idx*/, float /*t*/) { ++fhits; return false; });
+  }
+  fwatch.stop();
+  bwatch.start();
+  for (size_t i = 0; i < Q; ++i) {
+    vec_t o, d; ray(i, o, d);
+    const vec_t h = d * (0.5f * len);
+    stree.query({ wrap(o + h), abs(h) }, [&](auto idx) {
+      bhits += ray_entry(o, d, pop[idx], 0.f, len) <= len;
+    });
+  }
+  bwatch.stop();
+  size_t failed = 0;
+  std::vector<std::pair<float, size_t>> hits;
+  std::vector<size_t> found;
+  for (size_t i = 0; i < Q; i += 97) {
+    vec_t o, d; ray(i, o, d);
+    hits.clear();
+    stree.raycast(o, d, len, [&](auto idx, float t) { hits.emplace_back(t, size_t(idx)); });
+    // in the order of the entry distance, at the entry distance
+    failed += !std::is_sorted(hits.begin(), hits.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    found.clear();
+    for (const auto& hit : hits) {
+      found.push_back(hit.second);
+      failed += std::abs(hit.first - ray_entry(o, d, pop[hit.second], 0.f, len)) > 1e-5f;
+    }
+    failed += !bracketed(found,
+                         brute_force(pop, [&](const aabb_t& item) { return ray_entry(o, d, item, 0.f, len, -tol) <= len; }),
+                         brute_force(pop, [&](const aabb_t& item) { return ray_entry(o, d, item, 0.f, len) <= len; }));
+    size_t first = 0;
+    float tfirst = 0.f;
+    stree.raycast(o, d, len, [&](auto /*idx*/, float t) { ++first; tfirst = t; return false; });
+    failed += first != std::min<size_t>(hits.size(), 1);
+    if (first) {
+      failed += tfirst != hits.front().first;
+    }
+    // the rounded end point gives a slightly different ray
+    const vec_t b = wrap(o + len * d);
+    const vec_t ab = offset(b, o);
+    const float ab_len = std::sqrt(ab[0] * ab[0] + ab[1] * ab[1]);
+    const vec_t ab_dir = ab * (1.f / ab_len);
+    found.clear();
+    stree.segment_query(o, b, [&](auto idx, float /*t*/) { found.push_back(size_t(idx)); });
+    failed += !bracketed(found,
+                         brute_force(pop, [&](const aabb_t& item) { return ray_entry(o, ab_dir, item, 0.f, ab_len, -tol) <= ab_len; }),
+                         brute_force(pop, [&](const aabb_t& item) { return ray_entry(o, ab_dir, item, 0.f, ab_len) <= ab_len; }));
+  }
+  std::cout << "length " << len << ": "
+            << rwatch.elapsed<std::chrono::microseconds>().count() << " us raycast (" << rhits << "), "
+            << fwatch.elapsed<std::chrono::microseconds>().count() << " us first hit (" << fhits << "), "
+            << bwatch.elapsed<std::chrono::microseconds>().count() << " us box cover (" << bhits << "), "
+            << failed << " failed\n";
+  return failed;
+}
+
+
+// vision cones: polygon cull vs. bounding box of the cone.
+// Returns the number of cones whose hits differ from brute force.
+size_t cones(const std::vector<aabb_t>& pop, size_t Q, float len)
+{
+  hrtree_t stree;
+  stree.build(pop.cbegin(), pop.cend(), [](const auto& bbox) { return bbox; });
+  game_watches::stop_watch pwatch{};
+  game_watches::stop_watch bwatch{};
+  size_t phits = 0, bhits = 0, bcand = 0;
+  auto cone = [&](size_t i) {
+    const vec_t o = pop[(i * 7919) % pop.size()].center;
+    const float a = 6.2831853f * float(i) / float(Q);
+    const vec_t d = { std::cos(a), std::sin(a) };
+    const vec_t n = { -d[1], d[0] };
+    return std::array<vec_t, 3>{ o, o + len * d + (0.5f * len) * n, o + len * d - (0.5f * len) * n };
+  };
+  pwatch.start();
+  for (size_t i = 0; i < Q; ++i) {
+    const auto tri = cone(i);
+    stree.query(polygon_cull(tri.begin(), tri.end()), [&](auto /*idx*/) { ++phits; });
+  }
+  pwatch.stop();
+  bwatch.start();
+  for (size_t i = 0; i < Q; ++i) {
+    const auto tri = cone(i);
+    const polygon_cull cull(tri.begin(), tri.end());
+    const vec_t lo = min(min(tri[0], tri[1]), tri[2]);
+    const vec_t hi = max(max(tri[0], tri[1]), tri[2]);
+    stree.query({ wrap(0.5f * (lo + hi)), 0.5f * (hi - lo) }, [&](auto idx) {
+      ++bcand;
+      bhits += cull(pop[idx]);
+    });
+  }
+  bwatch.stop();
+  // the bounding box query rounds differently at the edges,
+  // compare the polygon query with brute force instead
+  size_t failed = 0;
+  std::vector<size_t> found;
+  for (size_t i = 0; i < Q; i += 97) {
+    const auto tri = cone(i);
+    const polygon_cull cull(tri.begin(), tri.end());
+    found.clear();
+    stree.query(cull, [&](auto idx) { found.push_back(size_t(idx)); });
+    failed += !bracketed(found, brute_force(pop, polygon_cull(tri.begin(), tri.end(), -tol)), brute_force(pop, cull));
+  }
+  std::cout << "length " << len << ": "
+            << pwatch.elapsed<std::chrono::microseconds>().count() << " us polygon (" << phits << "), "
+            << bwatch.elapsed<std::chrono::microseconds>().count() << " us bounding box (" << bhits << " of " << bcand << "), "
+            << failed << " failed\n";
+  return failed;
+}
+
+
+// The cull policies against brute force over the items: the tree shall
+// report the items the policy accepts, up to the rounding of the node
+// boxes. Discs and rings are also checked against the exact distances,
+// oriented boxes against the polygon of their corners. Returns the
+// number of disagreements.
+size_t shapes(const std::vector<aabb_t>& pop, size_t Q, float r)
+{
+  hrtree_t stree;
+  stree.build(pop.cbegin(), pop.cend(), [](const auto& bbox) { return bbox; });
+  size_t failed = 0, hits = 0;
+  std::vector<size_t> found;
+  auto check = [&](const auto& cull, const auto& strict) {
+    found.clear();
+    stree.query(cull, [&](auto idx) { found.push_back(size_t(idx)); });
+    failed += !bracketed(found, brute_force(pop, strict), brute_force(pop, cull));
+    hits += found.size();
+  };
+  auto dist = [](const vec_t& c, const aabb_t& bbox) {
+    const vec_t o = abs(offset(bbox.center, c));
+    const float nx = std::max(0.f, o[0] - bbox.radii[0]), ny = std::max(0.f, o[1] - bbox.radii[1]);
+    const float fx = o[0] + bbox.radii[0], fy = o[1] + bbox.radii[1];
+    return std::make_pair(std::sqrt(nx * nx + ny * ny), std::sqrt(fx * fx + fy * fy));
+  };
+  for (size_t i = 0; i < Q; i += 97) {
+    const vec_t c = pop[(i * 7919) % pop.size()].center;
+    const float a = 6.2831853f * float(i) / float(Q);
+    const vec_t u = { std::cos(a), std::sin(a) };
+    const vec_t v = { -u[1], u[0] };
+    const obb_cull obb(c, u, r, 0.3f * r);
+    const obb_cull obb_strict(c, u, r, 0.3f * r, -tol);
+    check(obb, obb_strict);
+    // the corners are rounded, the two shall only disagree at the edges
+    const std::array<vec_t, 4> corners = { c - r * u - 0.3f * r * v, c + r * u - 0.3f * r * v, c + r * u + 0.3f * r * v, c - r * u + 0.3f * r * v };
+    const polygon_cull poly(corners.begin(), corners.end());
+    const polygon_cull poly_strict(corners.begin(), corners.end(), -tol);
+    for (size_t j = 0; j < pop.size(); ++j) {
+      failed += (obb_strict(pop[j]) && !poly(pop[j])) || (poly_strict(pop[j]) && !obb(pop[j]));
+    }
+    const disc_cull disc(c, r);
+    check(disc, disc_cull(c, r, -tol));
+    const annulus_cull ring(c, 0.5f * r, r);
+    check(ring, annulus_cull(c, 0.5f * r, r, -tol));
+    for (size_t j = 0; j < pop.size(); ++j) {
+      const auto d = dist(c, pop[j]);
+      if (std::abs(d.first - r) > tol) failed += disc(pop[j]) != (d.first < r);
+      if (std::abs(d.first - r) > tol && std::abs(d.second - 0.5f * r) > tol) failed += ring(pop[j]) != (d.first < r && d.second > 0.5f * r);
+    }
+  }
+  std::cout << "size " << r << ": " << hits << " hits, " << failed << " failed\n";
+  return failed;
+}
+
+
+// child block prefetch off vs. on, same tree and queries.
+// Returns the number of rounds whose overlaps differ from the first.
+size_t prefetching(const std::vector<aabb_t>& pop, size_t Q)
+{
+  hrtree_t stree;
+  stree.build(pop.cbegin(), pop.cend(), [](const auto& bbox) { return bbox; });
+  size_t failed = 0, ref = 0;
+  bool first = true;
+  for (size_t lines : { size_t(0), size_t(HRTREE_PREFETCH_LINES), size_t(0), size_t(HRTREE_PREFETCH_LINES) }) {
+    stree.prefetch_lines(lines);
+    game_watches::stop_watch qwatch{};
+    size_t overlaps = 0;
+    qwatch.start();
+    for (size_t i = 0; i < Q; ++i) {
+      stree.query(pop[(i * 7919) % pop.size()], [&](auto /*idx*/) { ++overlaps; });
+    }
+    qwatch.stop();
+    if (first) ref = overlaps;
+    failed += overlaps != ref;
+    first = false;
+    std::cout << lines << " lines: " << qwatch.elapsed<std::chrono::microseconds>().count() << " us (" << overlaps << ")\n";
+  }
+  return failed;
+}
+
+
+// random steps of n agents in one block (simd + scalar tail) against
+// one agent at a time (scalar only). Returns the number of agents that
+// end up at different positions.
+size_t walks(size_t n, size_t steps)
+{
+  auto pdist = std::uniform_real_distribution<float>(0.0f, 1.0f);
+  std::vector<float> x(n), y(n);
+  for (size_t i = 0; i < n; ++i) {
+    x[i] = pdist(reng);
+    y[i] = pdist(reng);
+  }
+  auto sx = x, sy = y;
+  game_watches::stop_watch bwatch{};
+  game_watches::stop_watch swatch{};
+  size_t mismatches = 0;
+  for (uint32_t t = 0; t < steps; ++t) {
+    bwatch.start();
+    model::random_steps(x.data(), y.data(), n, 0, t, 0x1234, 0.01f);
+    bwatch.stop();
+    swatch.start();
+    for (size_t i = 0; i < n; ++i) {
+      model::random_steps(sx.data() + i, sy.data() + i, 1, uint32_t(i), t, 0x1234, 0.01f);
+    }
+    swatch.stop();
+  }
+  // shall not depend on the compiler flags either
+  uint32_t checksum = 0;
+  for (size_t i = 0; i < n; ++i) {
+    mismatches += (x[i] != sx[i]) || (y[i] != sy[i]);
+    uint32_t bx, by;
+    std::memcpy(&bx, &x[i], sizeof(float));
+    std::memcpy(&by, &y[i], sizeof(float));
+    checksum = 31 * checksum + (bx ^ (by << 1));
+  }
+  std::cout << n << " agents, " << steps << " steps: "
+            << bwatch.elapsed<std::chrono::microseconds>().count() << " us block, "
+            << swatch.elapsed<std::chrono::microseconds>().count() << " us one by one, "
+            << mismatches << " mismatches, checksum " << std::hex << checksum << std::dec << '\n';
+  return mismatches;
+}
+
+
+// lazy regrowth against a pass over all cells per step, with grazing
+// on random cells. Returns the number of reads and cells that differ.
+size_t regrowth(size_t S, size_t steps)
+{
+  const float rate = 0.01f, cap = 1.f, tol = 1e-4f;
+  regrowth_grid_t<float> lazy(S, 0.f, rate, cap);
+  grid_t<float> eager(S, 0.f);
+  auto pdist = std::uniform_real_distribution<float>(0.0f, 1.0f);
+  game_watches::stop_watch lwatch{};
+  game_watches::stop_watch ewatch{};
+  size_t failed = 0;
+  for (size_t t = 0; t < steps; ++t) {
+    lwatch.start();
+    lazy.advance();
+    lwatch.stop();
+    ewatch.start();
+    for (auto& val : eager) val = std::min(cap, val + rate);
+    ewatch.stop();
+    for (size_t k = 0; k < S; ++k) {
+      const vec_t pos = { pdist(reng), pdist(reng) };
+      const float val = static_cast<const regrowth_grid_t<float>&>(lazy)(pos);
+      failed += std::abs(val - eager(pos)) > tol;
+      lazy(pos) *= 0.5f;
+      eager(pos) *= 0.5f;
+    }
+  }
+  const auto& grid = lazy.materialize();
+  for (size_t i = 0; i < grid.size(); ++i) {
+    failed += std::abs(grid.data()[i] - eager.data()[i]) > tol;
+  }
+  std::cout << S << " x " << S << " cells, " << steps << " steps: "
+            << lwatch.elapsed<std::chrono::microseconds>().count() << " us lazy, "
+            << ewatch.elapsed<std::chrono::microseconds>().count() << " us eager, "
+            << failed << " failed\n";
+  return failed;
+}
+
+
 int main()
 {
+  size_t failed = 0;
   std::vector<aabb_t> pop;
   auto pdist = std::uniform_real_distribution<float>(0.0f, 1.0f);
   for (size_t i = 0; i < N; ++i) {
@@ -55,8 +576,82 @@ int main()
 
   std::cout << "hrtree_t\n";
   test<hrtree_t>(pop);
+  std::cout << "\ncompact_hrtree_t\n";
+  test<compact_hrtree_t>(pop);
   std::cout << "\nbrute_force_t\n";
   test<brute_force_t>(pop);
 
+  std::vector<aabb_t> large;
+  for (size_t i = 0; i < NL; ++i) {
+    large.push_back({ {pdist(reng), pdist(reng)}, {0.0005f, 0.0005f} });
+  }
+  std::cout << "\nhrtree_t, " << NL << " items\n";
+  test<hrtree_t>(large, QL);
+  memory<hrtree_t>(large);
+  std::cout << "\nprefetch, " << NL << " items\n";
+  failed += prefetching(large, QL);
+  std::cout << "\ncompact_hrtree_t, " << NL << " items\n";
+  test<compact_hrtree_t>(large, QL);
+  memory<compact_hrtree_t>(large);
+
+  std::vector<aabb_t> uniform;
+  for (size_t i = 0; i < NC; ++i) {
+    uniform.push_back({ {pdist(reng), pdist(reng)}, {0.001f, 0.001f} });
+  }
+  std::cout << "\ncurves, " << NC << " uniform items\n";
+  curves(uniform, QL);
+  auto blobs = clustered(NC, 0.001f);
+  std::cout << "\ncurves, " << NC << " items in " << NK << " clusters\n";
+  curves(blobs, QL);
+
+  std::cout << "\nadaptive re-sort, " << NC << " keys\n";
+  resort(NC);
+
+  std::cout << "\nquery modes, " << NC << " uniform items\n";
+  query_modes(uniform, QL);
+  std::cout << "\nquery modes, " << NC << " items in " << NK << " clusters\n";
+  query_modes(blobs, QL);
+
+  // elongated boxes of mixed size
+  std::vector<aabb_t> mixed;
+  auto rdist = std::uniform_real_distribution<float>(0.0001f, 0.004f);
+  for (size_t i = 0; i < NC; ++i) {
+    mixed.push_back({ {pdist(reng), pdist(reng)}, {rdist(reng), 0.25f * rdist(reng)} });
+  }
+  std::cout << "\npayload, " << NC << " uniform items\n";
+  failed += payloads(uniform, 1000, 0.002f);
+  failed += payloads(uniform, 1000, 0.01f);
+
+  std::cout << "\nearly exit, " << NC << " uniform items\n";
+  failed += early_exit<hrtree_t>(uniform, QL, 0.002f);
+  failed += early_exit<hrtree_t>(uniform, QL, 0.01f);
+
+  std::cout << "\nrays, " << NC << " uniform items\n";
+  failed += rays(uniform, QL, 0.01f);
+  failed += rays(uniform, QL, 0.1f);
+
+  std::cout << "\ncones, " << NC << " uniform items\n";
+  failed += cones(uniform, QL, 0.02f);
+  failed += cones(uniform, QL, 0.1f);
+
+  std::cout << "\nshapes, " << NC << " uniform items\n";
+  failed += shapes(uniform, QL, 0.01f);
+  failed += shapes(uniform, QL, 0.1f);
+
+  std::cout << "\norderings, " << NC << " uniform items\n";
+  orderings(uniform, QL);
+  std::cout << "\norderings, " << NC << " elongated items of mixed size\n";
+  orderings(mixed, QL);
+
+  std::cout << "\nregrowth\n";
+  failed += regrowth(512, 300);
+
+  std::cout << "\nrandom walks\n";
+  failed += walks(NC + 5, 100);
+
+  if (failed) {
+    std::cout << "\n" << failed << " checks failed\n";
+    return EXIT_FAILURE;
+  }
   return 0;
 }
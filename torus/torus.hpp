@@ -195,6 +195,63 @@ namespace torus {
   }
 
 
+  namespace detail {
+
+    // first interval [s, e] with e >= t in which u + d * t lies in [-r, r]
+    // modulo 1, for d >= 0 and inv_d = 1 / d.
+    inline void next_slab(float u, float d, float inv_d, float r, float t, float& s, float& e) noexcept
+    {
+      constexpr float inf = std::numeric_limits<float>::infinity();
+      if (r >= 0.5f) {
+        s = -inf; e = inf;
+      }
+      else if (d == 0.f) {
+        const bool inside = std::abs(wrap_ofs_coor(u)) <= r;
+        s = inside ? -inf : inf;
+        e = inf;
+      }
+      else {
+        float k = std::ceil(u + d * t - r);
+        e = (k + r - u) * inv_d;
+        if (e < t) {
+          k += 1.f;
+          e = (k + r - u) * inv_d;
+        }
+        s = (k - r - u) * inv_d;
+      }
+    }
+
+  }
+
+
+  // returns the smallest t in [t0, t1] at which the ray o + t * d is
+  // inside bbox, infinity if there is none. The ray is unrolled across
+  // the periodic boundary, i.e. bbox stands for all its images.
+  // o and bbox.center shall be wrapped.
+  inline float ray_entry(const vec_t& o, const vec_t& d, const aabb_t& bbox, float t0, float t1, float eps = reps) noexcept
+  {
+    // per axis: origin relative to the center, mirrored to d >= 0
+    float u[2], ad[2], inv[2], r[2];
+    for (int i = 0; i < 2; ++i) {
+      const float ofs = detail::wrap_ofs_coor(o[i] - bbox.center[i]);
+      u[i] = (d[i] < 0.f) ? -ofs : ofs;
+      ad[i] = std::abs(d[i]);
+      inv[i] = 1.f / ad[i];
+      r[i] = bbox.radii[i] + eps;
+    }
+    float t = t0;
+    for (;;) {
+      float sx, ex, sy, ey;
+      detail::next_slab(u[0], ad[0], inv[0], r[0], t, sx, ex);
+      detail::next_slab(u[1], ad[1], inv[1], r[1], t, sy, ey);
+      const float s = std::max(t, std::max(sx, sy));
+      if (!(s <= t1)) return std::numeric_limits<float>::infinity();
+      if (s <= ex && s <= ey) return s;
+      t = s;
+    }
+  }
+
+
   // returns the minimal bounding box that contains bbox and pt
   // bbox.center and pt shall be wrapped.
   inline aabb_t include(const aabb_t& bbox, const vec_t& pt) noexcept
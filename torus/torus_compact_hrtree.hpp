@@ -0,0 +1,211 @@
+#ifndef TORUS_COMPACT_HRTREE_HPP_INCLUDED
+#define TORUS_COMPACT_HRTREE_HPP_INCLUDED
+
+// Hilbert Rtree for torus::aabb_t without leaf level.
+// The item boxes are kept in curve order, bucket by bucket, as
+// structure of arrays. The tree indexes the buckets and queries test
+// all boxes of a hit bucket at once.
+//
+// all bugs are mine: Hanno 2021
+
+
+#include <vector>
+#include <limits>
+#include <hrtree/compact_rtree.hpp>
+#include <hrtree/arch/select.hpp>
+#include "torus_hrtree.hpp"
+
+
+namespace torus {
+
+
+  namespace detail {
+
+    // 8 boxes as structure of arrays, one AVX register per member.
+    // Unused slots have negative radii and never intersect.
+    struct HRTREE_ALIGN(32) box_bucket_t
+    {
+      static constexpr int size = 8;
+
+      float cx[size];
+      float cy[size];
+      float rx[size];
+      float ry[size];
+
+      void set(int j, const aabb_t& box) noexcept
+      {
+        cx[j] = box.center[0]; cy[j] = box.center[1];
+        rx[j] = box.radii[0]; ry[j] = box.radii[1];
+      }
+
+      void clear(int j) noexcept
+      {
+        cx[j] = cy[j] = 0.f;
+        rx[j] = ry[j] = -std::numeric_limits<float>::max();
+      }
+
+      aabb_t operator[](int j) const noexcept
+      {
+        return { { cx[j], cy[j] }, { rx[j], ry[j] } };
+      }
+    };
+
+
+#ifdef HRTREE_HAS_AVX
+
+    // abs(offset(q, c)) for 8 centers c
+    inline __m256 abs_offset(const float* c, float q) noexcept
+    {
+      const __m256 dir = _mm256_sub_ps(_mm256_set1_ps(q), _mm256_load_ps(c));
+      const __m256 one = _mm256_set1_ps(1.f);
+      const __m256 lo = _mm256_and_ps(_mm256_cmp_ps(dir, _mm256_set1_ps(-0.5f), _CMP_LT_OQ), one);
+      const __m256 hi = _mm256_and_ps(_mm256_cmp_ps(dir, _mm256_set1_ps(0.5f), _CMP_GE_OQ), one);
+      const __m256 ofs = _mm256_sub_ps(_mm256_add_ps(dir, lo), hi);
+      return _mm256_andnot_ps(_mm256_set1_ps(-0.f), ofs);
+    }
+
+
+    // bit j is set if intersects(bucket[j], bbox)
+    inline unsigned intersects(const box_bucket_t& bucket, const aabb_t& bbox) noexcept
+    {
+      const __m256 reps8 = _mm256_set1_ps(reps);
+      const __m256 rrx = _mm256_add_ps(_mm256_add_ps(_mm256_load_ps(bucket.rx), _mm256_set1_ps(bbox.radii[0])), reps8);
+      const __m256 rry = _mm256_add_ps(_mm256_add_ps(_mm256_load_ps(bucket.ry), _mm256_set1_ps(bbox.radii[1])), reps8);
+      const __m256 hx = _mm256_cmp_ps(abs_offset(bucket.cx, bbox.center[0]), rrx, _CMP_LE_OQ);
+      const __m256 hy = _mm256_cmp_ps(abs_offset(bucket.cy, bbox.center[1]), rry, _CMP_LE_OQ);
+      return static_cast<unsigned>(_mm256_movemask_ps(_mm256_and_ps(hx, hy)));
+    }
+
+#else
+
+    inline unsigned intersects(const box_bucket_t& bucket, const aabb_t& bbox) noexcept
+    {
+      unsigned mask = 0;
+      for (int j = 0; j < box_bucket_t::size; ++j) {
+        mask |= unsigned(torus::intersects(bucket[j], bbox)) << j;
+      }
+      return mask;
+    }
+
+#endif
+
+  }
+
+
+  // IndexT = int64_t supports more than 2^31 items
+  // Key selects the space filling curve, e.g. morton_key_t
+  template <typename IndexT = int32_t, typename Key = hilbert_key_t>
+  class basic_compact_hrtree
+  {
+  public:
+    using index_t = IndexT;
+    using key_type = Key;
+    static constexpr int bucket_size = detail::box_bucket_t::size;
+
+    basic_compact_hrtree() {}
+
+    template <typename RaIt, typename Conv>
+    void build(RaIt first, RaIt last, Conv conv);
+
+    // see basic_hrtree::query
+    template <typename Fun>
+    bool query(const aabb_t& bbox, Fun fun) const;
+
+    // true if any item overlaps bbox, stops at the first hit
+    bool any(const aabb_t& bbox) const
+    {
+      return !query(bbox, [](index_t) { return false; });
+    }
+
+    // number of items overlapping bbox, stops counting at k
+    size_t count_upto(const aabb_t& bbox, size_t k) const
+    {
+      size_t n = 0;
+      if (k) query(bbox, [&n, k](index_t) { return ++n < k; });
+      return n;
+    }
+
+    // tree, item boxes, key/index permutation and radix sort buffer.
+    // The bucket boxes replace the leaf level of hrtree_t.
+    hrtree::memory_footprint memory_usage() const
+    {
+      auto mf = tree_.memory_usage() + order_.memory_usage();
+      mf.levels += buckets_.size() * sizeof(detail::box_bucket_t);
+      mf.slack += (buckets_.capacity() - buckets_.size()) * sizeof(detail::box_bucket_t);
+      return mf;
+    }
+
+    // see basic_hrtree::adaptive_resort
+    void adaptive_resort(bool enable) { order_.adaptive(enable); }
+    bool adaptive_resort() const { return order_.adaptive(); }
+
+    // leaf order of the following builds, curve by default
+    void ordering(leaf_ordering o) { order_.ordering(o); }
+    leaf_ordering ordering() const { return order_.ordering(); }
+
+  private:
+    hrtree::compact_rtree<aabb_t, detail::aabb_build_policy, bucket_size, hrtree::huge_page_allocator<aabb_t>> tree_;
+    std::vector<detail::box_bucket_t, hrtree::huge_page_allocator<detail::box_bucket_t>> buckets_;
+    detail::curve_order<IndexT, Key, bucket_size, bucket_size> order_;
+  };
+
+
+  using compact_hrtree_t = basic_compact_hrtree<int32_t>;
+
+
+  template <typename IndexT, typename Key>
+  template <typename RaIt, typename Conv>
+  void basic_compact_hrtree<IndexT, Key>::build(RaIt first, RaIt last, Conv conv)
+  {
+    order_.sort(first, last, conv);
+    const size_t N = order_.size();
+    const size_t B = (N + bucket_size - 1) / bucket_size;
+    tree_.build_index(N);
+    buckets_.resize(B);
+    if (N) {
+      // store item boxes in curve order, the bucket bv on the fly
+      for (size_t b = 0; b < B; ++b) {
+        detail::box_bucket_t& bucket = buckets_[b];
+        aabb_t bv;
+        for (int j = 0; j < bucket_size; ++j) {
+          const size_t i = b * bucket_size + j;
+          if (i < N) {
+            const aabb_t box = conv(first[order_[i]]);
+            bucket.set(j, box);
+            bv = (j == 0) ? box : include(bv, box);
+          }
+          else {
+            bucket.clear(j);
+          }
+        }
+        tree_.leaf_bv(b) = bv;
+      }
+      tree_.build_hierarchy();
+    }
+  }
+
+
+  template <typename IndexT, typename Key>
+  template <typename Fun>
+  bool basic_compact_hrtree<IndexT, Key>::query(const aabb_t& bbox, Fun fun) const
+  {
+    auto range_fun = [&](size_t i0, size_t i1) {
+      for (size_t b = i0 / bucket_size; i0 < i1; ++b, i0 += bucket_size) {
+        unsigned mask = detail::intersects(buckets_[b], bbox);
+        for (size_t i = i0; mask; ++i, mask >>= 1) {
+          if ((mask & 1) && !hrtree::invoke_visitor(fun, order_[i])) return false;
+        }
+      }
+      return true;
+    };
+    return tree_.query_buckets(
+      [&bbox](const aabb_t& rhs) {
+        return intersects(bbox, rhs);
+      },
+      range_fun
+    );
+  }
+
+}
+
+#endif
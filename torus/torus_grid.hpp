@@ -6,7 +6,10 @@
 // all bugs are mine: Hanno 2021
 
 
+#include <cstdint>
 #include <vector>
+#include <algorithm>
+#include <hrtree/memory/memory_footprint.hpp>
 #include "torus.hpp"
 
 
@@ -29,16 +32,16 @@ namespace torus {
 
     const T& operator()(const vec_t& coor) const noexcept
     {
-      const auto wp = wrap(coor);
-      const auto s = static_cast<float>(S_);
-      const auto ix = static_cast<size_t>(s * wp[0]);
-      const auto iy = static_cast<size_t>(s * wp[1]);
-      assert(ix < S_);
-      assert(iy < S_);
-      return *(data_.data() + iy * S_ + ix);
+      return *(data_.data() + index(coor));
     }
 
     T& operator()(const vec_t& coor) noexcept
+    {
+      return *(data_.data() + index(coor));
+    }
+
+    // linear index of the cell under coor
+    size_t index(const vec_t& coor) const noexcept
     {
       const auto wp = wrap(coor);
       const auto s = static_cast<float>(S_);
@@ -46,7 +49,7 @@ namespace torus {
       const auto iy = static_cast<size_t>(s * wp[1]);
       assert(ix < S_);
       assert(iy < S_);
-      return *(data_.data() + iy * S_ + ix);
+      return iy * S_ + ix;
     }
 
     float pixel_radius() const noexcept
@@ -76,11 +79,92 @@ namespace torus {
     const T* data() const noexcept { return data_.data(); }
     T* data() noexcept { return data_.data(); }
 
+    hrtree::memory_footprint memory_usage() const noexcept
+    {
+      return hrtree::memory::container_footprint(data_);
+    }
+
   private:
     size_t S_;
     std::vector<T> data_;
   };
 
+
+  // grid of a resource that grows back by rate per step, up to cap.
+  // Instead of a pass over all cells per step, every cell remembers the
+  // step it was last accessed and catches up on access. Pays off if only
+  // a fraction of the cells is accessed per step.
+  template <typename T>
+  class regrowth_grid_t
+  {
+  public:
+    regrowth_grid_t(size_t S, T val, T rate, T cap) : 
+      data_(S, val), 
+      stamp_(S * S, 0), 
+      rate_(rate), 
+      cap_(cap) 
+    {}
+
+    size_t size() const noexcept { return data_.size(); }
+    size_t wh() const noexcept { return data_.wh(); }
+
+    // one step of regrowth
+    void advance() noexcept { ++now_; }
+    uint32_t now() const noexcept { return now_; }
+
+    // current value
+    T operator()(const vec_t& coor) const noexcept
+    {
+      const size_t i = data_.index(coor);
+      return grown(data_.data()[i], now_ - stamp_[i]);
+    }
+
+    // current value, for writing
+    T& operator()(const vec_t& coor) noexcept
+    {
+      const size_t i = data_.index(coor);
+      return catch_up(i);
+    }
+
+    float pixel_radius() const noexcept { return data_.pixel_radius(); }
+    vec_t pixel_radii() const noexcept { return data_.pixel_radii(); }
+    aabb_t pixel(const vec_t& coor) const noexcept { return data_.pixel(coor); }
+
+    // brings all cells up to date, e.g. for output
+    const grid_t<T>& materialize() noexcept
+    {
+      for (size_t i = 0; i < size(); ++i) {
+        catch_up(i);
+      }
+      return data_;
+    }
+
+    hrtree::memory_footprint memory_usage() const noexcept
+    {
+      return data_.memory_usage() + hrtree::memory::container_footprint(stamp_);
+    }
+
+  private:
+    T grown(T val, uint32_t steps) const noexcept
+    {
+      return steps ? std::min(cap_, val + static_cast<T>(steps) * rate_) : val;
+    }
+
+    T& catch_up(size_t i) noexcept
+    {
+      T& val = data_.data()[i];
+      val = grown(val, now_ - stamp_[i]);
+      stamp_[i] = now_;
+      return val;
+    }
+
+    grid_t<T> data_;
+    std::vector<uint32_t> stamp_;
+    T rate_;
+    T cap_;
+    uint32_t now_ = 0;
+  };
+
 }
 
 #endif
@@ -6,11 +6,22 @@
 // all bugs are mine: Hanno 2021
 
 
+#include <cassert>
 #include <vector>
+#include <algorithm>
+#include <type_traits>
 #include <hrtree/isfc/hilbert.hpp>
+#include <hrtree/isfc/morton.hpp>
+#include <hrtree/isfc/gray.hpp>
 #include <hrtree/isfc/key_gen.hpp>
-#include <hrtree/sorting/radix_sort.hpp>
+#include <hrtree/isfc/key_ranges.hpp>
+#include <hrtree/sorting/packed_radix_sort.hpp>
+#include <hrtree/sorting/adaptive_sort.hpp>
+#include <hrtree/sorting/str_sort.hpp>
+#include <hrtree/sorting/omt_sort.hpp>
 #include <hrtree/rtree.hpp>
+#include <hrtree/visitor.hpp>
+#include <hrtree/memory/huge_page_allocator.hpp>
 #include "torus.hpp"
 
 
@@ -41,78 +52,386 @@ namespace torus {
       }
     };
   
+    // stands in for the payload of trees without one
+    struct no_payload {};
+
+    // narrow inner nodes over wide leaf nodes
+    constexpr size_t leaf_fanout = 16;
+    constexpr size_t node_fanout = 4;
+
     // Hilbert values and radix-sort stuff
     using key_t = hrtree::hilbert<2, 15>::type;          // 2D 'Hilbert value' of order 15
-    using keygen_t = hrtree::key_gen_01<key_t, vec_t>;   // pick a generator
-    using keyidx_t = std::pair<key_t::word_type, uint32_t>;
+    using keyidx_t = hrtree::packed_keyidx_t;            // <Hilbert value, index>
+
+    template <typename Key>
+    using keygen_t = hrtree::key_gen_01<Key, vec_t>;     // pick a generator
+
+    // index bits in the packed record: 32 for 32-bit indices, all bits
+    // not taken by the curve key otherwise.
+    template <typename IndexT, typename Key = key_t>
+    struct index_bits
+    {
+      static constexpr int value = (sizeof(IndexT) <= 4) ? 32 : 64 - Key::key_bits;
+      static_assert(Key::key_bits + value <= 64, "curve key doesn't fit into packed key/index record");
+    };
+
+  }
+
+
+  namespace detail {
+
+    // Key arguments [lo, hi] of the item centers within c +/- r, widened
+    // by one argument against rounding. Returns the number of pieces, two
+    // if the interval crosses the seam of the torus.
+    template <typename Key>
+    inline int curve_interval(float c, float r, typename Key::arg_type* lo, typename Key::arg_type* hi)
+    {
+      using arg_type = typename Key::arg_type;
+      const int64_t max_arg = static_cast<int64_t>(Key::max_arg);
+      auto to_arg = [max_arg](float x, int64_t widen) {
+        const int64_t a = static_cast<int64_t>(x * static_cast<float>(max_arg)) + widen;
+        return static_cast<arg_type>(std::max<int64_t>(0, std::min(a, max_arg)));
+      };
+      const float a = c - r;
+      const float b = c + r;
+      if (a >= 0.f && b < 1.f) {
+        lo[0] = to_arg(a, -1); hi[0] = to_arg(b, +1);
+        return 1;
+      }
+      if (2.f * r < 1.f) {
+        lo[0] = to_arg((a < 0.f) ? a + 1.f : a, -1); hi[0] = static_cast<arg_type>(max_arg);
+        lo[1] = 0; hi[1] = to_arg((b >= 1.f) ? b - 1.f : b, +1);
+        if (hi[1] < lo[0]) return 2;
+      }
+      lo[0] = 0; hi[0] = static_cast<arg_type>(max_arg);
+      return 1;
+    }
+
+  }
 
-    // radix sort is a bit of a pain (but fast)
-    // works with the bytes of the memory representation and
-    // needs to be told where to find them 
-    struct keyidx_conv_t
+
+  // Curve keys for the Key parameter of the trees. Hilbert gives the
+  // tightest nodes, Morton the cheapest keys, Gray is in between.
+  using hilbert_key_t = hrtree::hilbert<2, 15>::type;
+  using morton_key_t = hrtree::morton<2, 15>::type;
+  using gray_key_t = hrtree::gray<2, 15>::type;
+
+
+  // Leaf order of the trees.
+  enum class leaf_ordering
+  {
+    curve,    // along the curve of Key, cheap and incremental (default)
+    str,      // Sort-Tile-Recursive, tighter nodes for elongated or mixed-size boxes
+    omt       // top-down partitioning, slowest build, for long-lived trees
+  };
+
+
+  namespace detail {
+
+    // <curve key, index> permutation of the items, shared by the trees.
+    // The keys are zero after an STR or OMT sort, which tile for a tree
+    // of the given fanouts.
+    template <typename IndexT, typename Key, size_t LeafFanout = leaf_fanout, size_t NodeFanout = node_fanout>
+    class curve_order
     {
-      static constexpr int key_bytes = key_t::key_bytes;
-      const std::uint8_t* operator()(const keyidx_t& x) const 
+    public:
+      using index_t = IndexT;
+      static constexpr int index_bits = detail::index_bits<IndexT, Key>::value;
+
+      // (re-)generates and sorts the keys of [first, last).
+      template <typename RaIt, typename Conv>
+      void sort(RaIt first, RaIt last, Conv conv);
+
+      size_t size() const { return ki_.size(); }
+
+      // true if the last sort was along the curve
+      bool has_keys() const { return leaf_ordering::curve == sorted_; }
+
+      // first position >= pos with a key not less than key.
+      // Gallops from pos, successive lookups are usually close.
+      size_t lower_bound(std::uint64_t key, size_t pos) const
+      {
+        const keyidx_t x = hrtree::pack_keyidx<index_bits>(key, 0);
+        size_t step = 1;
+        size_t last = pos;
+        while (last < ki_.size() && ki_[last] < x) {
+          pos = last + 1;
+          last += step;
+          step <<= 1;
+        }
+        last = std::min(last, ki_.size());
+        return std::lower_bound(ki_.cbegin() + pos, ki_.cbegin() + last, x) - ki_.cbegin();
+      }
+
+      // key of the i-th item in curve order
+      std::uint64_t key(size_t i) const
+      {
+        return hrtree::packed_key<index_bits>(ki_[i]);
+      }
+
+      // index of the i-th item in curve order
+      index_t operator[](size_t i) const
+      {
+        return static_cast<index_t>(hrtree::packed_index<index_bits>(ki_[i]));
+      }
+
+      hrtree::memory_footprint memory_usage() const
       {
-        return reinterpret_cast<const std::uint8_t*>(std::addressof(x.first));
+        hrtree::memory_footprint mf;
+        mf.permutation = ki_.size() * sizeof(keyidx_t);
+        mf.sort_scratch = ki_buf_.size() * sizeof(keyidx_t);
+        mf.slack = (ki_.capacity() - ki_.size() + ki_buf_.capacity() - ki_buf_.size()) * sizeof(keyidx_t);
+        return mf;
       }
+
+      void adaptive(bool enable) { adaptive_ = enable; }
+      bool adaptive() const { return adaptive_; }
+
+      void ordering(leaf_ordering o) { ordering_ = o; }
+      leaf_ordering ordering() const { return ordering_; }
+
+    private:
+      template <typename RaIt, typename Conv>
+      void tile_sort(RaIt first, Conv conv);
+
+      std::vector<keyidx_t, hrtree::huge_page_allocator<keyidx_t>> ki_;
+      std::vector<keyidx_t, hrtree::huge_page_allocator<keyidx_t>> ki_buf_;  // some more that is needed by radix-sort
+      bool adaptive_ = true;
+      leaf_ordering ordering_ = leaf_ordering::curve;
+      leaf_ordering sorted_ = leaf_ordering::curve;
     };
 
+
+    template <typename IndexT, typename Key, size_t LeafFanout, size_t NodeFanout>
+    template <typename RaIt, typename Conv>
+    void curve_order<IndexT, Key, LeafFanout, NodeFanout>::sort(RaIt first, RaIt last, Conv conv)
+    {
+      const auto N = static_cast<index_t>(std::distance(first, last));
+      const bool resort = adaptive_ && (N == static_cast<index_t>(ki_.size()));
+      ki_.resize(N);
+      ki_buf_.resize(N);
+      sorted_ = ordering_;
+      if (0 == N) return;
+      if (leaf_ordering::curve != ordering_) {
+        tile_sort(first, conv);
+        return;
+      }
+      keygen_t<Key> keygen{};
+      if (resort) {
+        // regenerate Hilbert values in the previous, nearly sorted order.
+        // keys are generated sequentially, the gather goes to the compact key array
+        for (index_t i = 0; i < N; ++i) {
+          ki_buf_[i] = keygen(conv(first[i]).center).asWord();
+        }
+        for (index_t i = 0; i < N; ++i) {
+          const auto idx = hrtree::packed_index<index_bits>(ki_[i]);
+          ki_[i] = hrtree::pack_keyidx<index_bits>(ki_buf_[idx], idx);
+        }
+      }
+      else {
+        // generate <Hilbert value, index> pairs
+        for (index_t i = 0; i < N; ++i) {
+          ki_[i] = hrtree::pack_keyidx<index_bits>(keygen(conv(first[i]).center).asWord(), i);
+        }
+      }
+      // sort by Hilbert values
+      if (!resort || hrtree::sorting::adaptive_too_unsorted == hrtree::adaptive_sort(ki_.begin(), ki_.end(), ki_buf_.begin())) {
+        if (hrtree::packed_radix_sort<index_bits>(ki_.begin(), ki_.end(), ki_buf_.begin(), Key::key_bits)) {
+          ki_.swap(ki_buf_);
+        }
+      }
+    }
+
+
+    template <typename IndexT, typename Key, size_t LeafFanout, size_t NodeFanout>
+    template <typename RaIt, typename Conv>
+    void curve_order<IndexT, Key, LeafFanout, NodeFanout>::tile_sort(RaIt first, Conv conv)
+    {
+      struct center_idx
+      {
+        vec_t center;
+        index_t idx;
+      };
+      const size_t N = ki_.size();
+      std::vector<center_idx> ci(N);
+      for (size_t i = 0; i < N; ++i) {
+        ci[i] = { conv(first[i]).center, static_cast<index_t>(i) };
+      }
+      auto center = [](const center_idx& x) -> const vec_t& { return x.center; };
+      if (leaf_ordering::str == ordering_) {
+        std::vector<center_idx> buf(N);
+        hrtree::str_sort<LeafFanout, NodeFanout>(ci.begin(), ci.end(), buf.begin(), center);
+      }
+      else {
+        hrtree::omt_sort<LeafFanout, NodeFanout>(ci.begin(), ci.end(), center);
+      }
+      for (size_t i = 0; i < N; ++i) {
+        ki_[i] = hrtree::pack_keyidx<index_bits>(0, ci[i].idx);
+      }
+    }
+
   }
 
 
-  class hrtree_t
+  // IndexT = int64_t supports more than 2^31 items
+  // Key selects the space filling curve, e.g. morton_key_t
+  // Payload, if not void, is stored in leaf order next to the leaves.
+  template <typename IndexT = int32_t, typename Key = hilbert_key_t, typename Payload = void>
+  class basic_hrtree
   {
+    using payload_store_t = std::conditional_t<std::is_void<Payload>::value, detail::no_payload, Payload>;
+
   public:
-    using index_t = int32_t;
+    using index_t = IndexT;
+    using key_type = Key;
+    using payload_type = Payload;
+    static constexpr int index_bits = detail::index_bits<IndexT, Key>::value;
 
-    hrtree_t() {}
+    basic_hrtree() {}
 
     template <typename RaIt, typename Conv>
-    void build(RaIt first, RaIt last, Conv conv);
+    void build(RaIt first, RaIt last, Conv conv)
+    {
+      build(first, last, conv, detail::no_payload{});
+    }
+
+    // as above, stores pay(item) next to the leaf of item.
+    template <typename RaIt, typename Conv, typename Pay>
+    void build(RaIt first, RaIt last, Conv conv, Pay pay);
+
+    // fun(index) for the items overlapping bbox. fun may return bool,
+    // false stops the query. Returns false if the query was stopped.
+    template <typename Fun>
+    bool query(const aabb_t& bbox, Fun fun) const;
+
+    // fun(index) for the items accepted by cull(const aabb_t&), e.g.
+    // one of the shapes in torus_shapes.hpp. cull shall accept every
+    // box that contains an accepted one.
+    template <typename Cull, typename Fun, typename = std::enable_if_t<!std::is_convertible<Cull, aabb_t>::value>>
+    bool query(const Cull& cull, Fun fun) const
+    {
+      auto wfun = [fun = fun, &order = order_](size_t i) { return fun(order[i]); };
+      return hrtree_.query(cull, wfun);
+    }
+
+    // fun(const Payload&) for the items overlapping bbox. A hit reads the
+    // payload stored next to its leaf, neither the index nor the item.
+    // Requires a build with payload.
+    template <typename Fun>
+    bool query_payload(const aabb_t& bbox, Fun fun) const;
+
+    // true if any item overlaps bbox, stops at the first hit
+    bool any(const aabb_t& bbox) const
+    {
+      return !query(bbox, [](index_t) { return false; });
+    }
+
+    // number of items overlapping bbox, stops counting at k
+    size_t count_upto(const aabb_t& bbox, size_t k) const
+    {
+      size_t n = 0;
+      if (k) query(bbox, [&n, k](index_t) { return ++n < k; });
+      return n;
+    }
+
+    // fun(index, t) for the items hit by the ray origin + t * dir,
+    // t in [0, max_len], in the order of their entry distance t.
+    // The ray wraps around the torus. fun may return bool, false
+    // stops the query, e.g. after the first hit. dir needs not to be
+    // normalized, t is in units of length.
+    template <typename Fun>
+    bool raycast(const vec_t& origin, const vec_t& dir, float max_len, Fun fun) const;
+
+    // raycast along the shortest path from a to b.
+    template <typename Fun>
+    bool segment_query(const vec_t& a, const vec_t& b, Fun fun) const
+    {
+      const vec_t ab = offset(b, a);
+      const float len = std::sqrt(ab[0] * ab[0] + ab[1] * ab[1]);
+      if (len == 0.f) return query(aabb_t{ a, { 0.f, 0.f } }, [&fun](index_t i) { return hrtree::invoke_visitor(fun, i, 0.f); });
+      return raycast(a, ab, len, fun);
+    }
 
+    // Same result as query, without the tree: the box, grown by the
+    // largest item radii, is decomposed into key intervals at curve
+    // depth resolution, which are looked up in the sorted keys.
+    // resolution = 0 picks cells of about half the grown box.
+    // Pays off for small boxes, e.g. pixel sized queries.
     template <typename Fun>
-    void query(const aabb_t& bbox, Fun fun) const;
+    bool query_curve(const aabb_t& bbox, Fun fun, int resolution = 0) const;
+
+    // tree and payload, key/index permutation and radix sort buffer
+    hrtree::memory_footprint memory_usage() const
+    {
+      hrtree::memory_footprint mf = hrtree_.memory_usage() + order_.memory_usage();
+      mf.levels += payload_.size() * sizeof(payload_store_t);
+      mf.slack += (payload_.capacity() - payload_.size()) * sizeof(payload_store_t);
+      return mf;
+    }
+
+    // if enabled (default), a build with an unchanged number of items
+    // regenerates the keys in the previous order and repairs that order
+    // instead of sorting from scratch. Falls back to radix sort if the
+    // order is too far off. Items with equal Hilbert values might
+    // end up in a different order than after a fresh build.
+    void adaptive_resort(bool enable) { order_.adaptive(enable); }
+    bool adaptive_resort() const { return order_.adaptive(); }
+
+    // leaf order of the following builds, curve by default.
+    // query_curve falls back to query after an STR build.
+    void ordering(leaf_ordering o) { order_.ordering(o); }
+    leaf_ordering ordering() const { return order_.ordering(); }
+
+    // cache lines of a child block prefetched during traversal, 0: none.
+    // Defaults to HRTREE_PREFETCH_LINES.
+    void prefetch_lines(size_t lines) { hrtree_.prefetch_lines(lines); }
+    size_t prefetch_lines() const { return hrtree_.prefetch_lines(); }
 
   private:
-    hrtree::rtree<aabb_t, detail::aabb_build_policy, 8> hrtree_;
-    std::vector<detail::keyidx_t> ki_;      
-    std::vector<detail::keyidx_t> ki_buf_;  // some more that is needed by radix-sort
+    // large trees and sort buffers are backed by huge pages
+    hrtree::rtree<aabb_t, detail::aabb_build_policy, detail::node_fanout, hrtree::huge_page_allocator<aabb_t>, hrtree::level_layout, detail::leaf_fanout> hrtree_;
+    detail::curve_order<IndexT, Key> order_;
+    std::vector<payload_store_t, hrtree::huge_page_allocator<payload_store_t>> payload_;
+    vec_t max_radii_ = { 0.f, 0.f };
   };
 
 
-  template <typename RaIt, typename Conv>
-  void hrtree_t::build(RaIt first, RaIt last, Conv conv)
+  using hrtree_t = basic_hrtree<int32_t>;
+
+
+  template <typename IndexT, typename Key, typename Payload>
+  template <typename RaIt, typename Conv, typename Pay>
+  void basic_hrtree<IndexT, Key, Payload>::build(RaIt first, RaIt last, Conv conv, Pay pay)
   {
-    const auto N = static_cast<index_t>(std::distance(first, last));
-    ki_.resize(N);
-    ki_buf_.resize(N);
+    constexpr bool with_payload = !std::is_same<Pay, detail::no_payload>::value;
+    static_assert(!with_payload || !std::is_void<Payload>::value, "basic_hrtree: payload of a tree without Payload type");
+    order_.sort(first, last, conv);
+    const size_t N = order_.size();
     hrtree_.build_index(N);   // i.e. allocate memory for our leaves
+    payload_.resize(with_payload ? N : 0);
+    max_radii_ = { 0.f, 0.f };
     if (N) {
-      // generate <Hilbert value, index> pairs
-      detail::keygen_t keygen{};
-      for (index_t i = 0; i < N; ++i) {
-        ki_[i] = { keygen(conv(first[i]).center).asWord(), i };
-      }
-      // sort by Hilbert values
-      if (hrtree::radix_sort(ki_.begin(), ki_.end(), ki_buf_.begin(), detail::keyidx_conv_t{})) {
-        ki_.swap(ki_buf_);
-      }
-      // store leaves in Hilbert value order
-      auto dummy = hrtree_.level_begin(0);
-      for (index_t i = 0; i < N; ++i) {
-        hrtree_.leaf_bv(i) = conv(first[ki_[i].second]);
+      // store leaves in curve order
+      for (size_t i = 0; i < N; ++i) {
+        const auto& item = first[order_[i]];
+        const aabb_t box = conv(item);
+        hrtree_.leaf_bv(i) = box;
+        max_radii_ = max(max_radii_, box.radii);
+        if constexpr (with_payload) {
+          payload_[i] = pay(item);
+        }
       }
       hrtree_.build_hierarchy();
     }
   }
 
 
+  template <typename IndexT, typename Key, typename Payload>
   template <typename Fun>
-  void hrtree_t::query(const aabb_t& bbox, Fun fun) const
+  bool basic_hrtree<IndexT, Key, Payload>::query(const aabb_t& bbox, Fun fun) const
   {
-    auto wfun = [fun = fun, it = ki_.cbegin()](size_t i) { fun((it + i)->second); };
-    hrtree_.query(
+    auto wfun = [fun = fun, &order = order_](size_t i) { return fun(order[i]); };
+    return hrtree_.query(
       [bbox = bbox](const aabb_t& rhs) {
         return intersects(bbox, rhs);
       },
@@ -121,6 +440,106 @@ namespace torus {
   }
 
 
+  template <typename IndexT, typename Key, typename Payload>
+  template <typename Fun>
+  bool basic_hrtree<IndexT, Key, Payload>::query_payload(const aabb_t& bbox, Fun fun) const
+  {
+    static_assert(!std::is_void<Payload>::value, "basic_hrtree: query_payload on a tree without Payload type");
+    assert(payload_.size() == order_.size());
+    auto wfun = [fun = fun, &payload = payload_](size_t i) { return fun(payload[i]); };
+    return hrtree_.query(
+      [bbox = bbox](const aabb_t& rhs) {
+        return intersects(bbox, rhs);
+      },
+      wfun
+    );
+  }
+
+
+  template <typename IndexT, typename Key, typename Payload>
+  template <typename Fun>
+  bool basic_hrtree<IndexT, Key, Payload>::raycast(const vec_t& origin, const vec_t& dir, float max_len, Fun fun) const
+  {
+    const float len = std::sqrt(dir[0] * dir[0] + dir[1] * dir[1]);
+    if (hrtree_.empty() || !(len > 0.f) || max_len < 0.f) return true;
+    const vec_t o = wrap(origin);
+    const vec_t d = dir * (1.f / len);
+    // best first: nodes and leaves ordered by entry distance
+    struct entry {
+      float t;
+      size_t level;
+      size_t i;
+      bool operator<(const entry& rhs) const { return t > rhs.t; }
+    };
+    std::vector<entry> heap;
+    auto push = [&](size_t level, size_t i, float t0) {
+      const float t = ray_entry(o, d, *hrtree_.node(level, i), t0, max_len);
+      if (t <= max_len) {
+        heap.push_back({ t, level, i });
+        std::push_heap(heap.begin(), heap.end());
+      }
+    };
+    const size_t top = hrtree_.height() - 1;
+    for (size_t i = 0; i < hrtree_.level_nodes(top); ++i) {
+      push(top, i, 0.f);
+    }
+    while (!heap.empty()) {
+      std::pop_heap(heap.begin(), heap.end());
+      const entry e = heap.back();
+      heap.pop_back();
+      if (0 == e.level) {
+        if (!hrtree::invoke_visitor(fun, order_[e.i], e.t)) return false;
+        continue;
+      }
+      // children are entered not before their parent
+      const size_t F = hrtree_.child_fanout(e.level);
+      const size_t c1 = std::min((e.i + 1) * F, hrtree_.level_nodes(e.level - 1));
+      for (size_t c = e.i * F; c < c1; ++c) {
+        push(e.level - 1, c, e.t);
+      }
+    }
+    return true;
+  }
+
+
+  template <typename IndexT, typename Key, typename Payload>
+  template <typename Fun>
+  bool basic_hrtree<IndexT, Key, Payload>::query_curve(const aabb_t& bbox, Fun fun, int resolution) const
+  {
+    using arg_type = typename Key::arg_type;
+    if (!order_.has_keys()) {
+      return query(bbox, fun);
+    }
+    if (0 == order_.size()) return true;
+    const vec_t r = bbox.radii + max_radii_ + reps;
+    if (resolution <= 0) {
+      // cells of about half the grown box, holding a few items at least
+      const float cell = std::max(0.5f * std::max(r[0], r[1]), std::sqrt(8.f / order_.size()));
+      for (resolution = 1; resolution < Key::order && std::ldexp(1.f, -(resolution + 1)) >= cell; ++resolution);
+    }
+    arg_type lo[2][2], hi[2][2];
+    const int nx = detail::curve_interval<Key>(bbox.center[0], r[0], lo[0], hi[0]);
+    const int ny = detail::curve_interval<Key>(bbox.center[1], r[1], lo[1], hi[1]);
+    // up to four boxes if the query crosses the seams
+    arg_type blo[4 * 2], bhi[4 * 2];
+    int boxes = 0;
+    for (int ix = 0; ix < nx; ++ix) {
+      for (int iy = 0; iy < ny; ++iy, ++boxes) {
+        blo[2 * boxes] = lo[0][ix]; blo[2 * boxes + 1] = lo[1][iy];
+        bhi[2 * boxes] = hi[0][ix]; bhi[2 * boxes + 1] = hi[1][iy];
+      }
+    }
+    const size_t N = order_.size();
+    size_t pos = 0;
+    return hrtree::key_ranges<Key>(blo, bhi, boxes, resolution, [&](std::uint64_t k0, std::uint64_t k1) {
+      for (pos = order_.lower_bound(k0, pos); pos < N && order_.key(pos) < k1; ++pos) {
+        if (intersects(bbox, hrtree_.leaf_bv(pos)) && !hrtree::invoke_visitor(fun, order_[pos])) return false;
+      }
+      return true;
+    });
+  }
+
+
   // for comparison ;)
   class brute_force_t
   {
@@ -137,13 +556,28 @@ namespace torus {
     }
 
     template <typename Fun>
-    void query(const aabb_t& bbox, Fun fun) const
+    bool query(const aabb_t& bbox, Fun fun) const
     {
       for (size_t i = 0; i < leaves_.size(); ++i) {
-        if (intersects(leaves_[i], bbox)) {
-          fun(i);
+        if (intersects(leaves_[i], bbox) && !hrtree::invoke_visitor(fun, i)) {
+          return false;
         }
       }
+      return true;
+    }
+
+    // true if any item overlaps bbox, stops at the first hit
+    bool any(const aabb_t& bbox) const
+    {
+      return !query(bbox, [](size_t) { return false; });
+    }
+
+    // number of items overlapping bbox, stops counting at k
+    size_t count_upto(const aabb_t& bbox, size_t k) const
+    {
+      size_t n = 0;
+      if (k) query(bbox, [&n, k](size_t) { return ++n < k; });
+      return n;
     }
 
   private:
@@ -0,0 +1,144 @@
+#ifndef TORUS_SHAPES_HPP_INCLUDED
+#define TORUS_SHAPES_HPP_INCLUDED
+
+// cull policies for torus::aabb_t: convex polygon, oriented box,
+// disc and annulus. To be passed to basic_hrtree::query.
+// Shapes shall fit into half the torus.
+//
+// all bugs are mine: Hanno 2021
+
+
+#include <algorithm>
+#include <hrtree/shape_intersect_policy.hpp>
+#include "torus.hpp"
+
+
+namespace torus {
+
+  namespace detail {
+
+    // test(dx, dy, rx, ry) for the images of bbox, relative to ref, that
+    // might reach the extent ext of a shape around ref.
+    template <typename Test>
+    inline bool any_image(const vec_t& ref, const vec_t& ext, const aabb_t& bbox, float eps, Test test)
+    {
+      const float rx = bbox.radii[0] + eps;
+      const float ry = bbox.radii[1] + eps;
+      float ox[2], oy[2];
+      int nx = 1, ny = 1;
+      ox[0] = wrap_ofs_coor(bbox.center[0] - ref[0]);
+      oy[0] = wrap_ofs_coor(bbox.center[1] - ref[1]);
+      // the neighbor image on the other side
+      const float ax = ox[0] - std::copysign(1.f, ox[0]);
+      const float ay = oy[0] - std::copysign(1.f, oy[0]);
+      if (std::abs(ax) <= rx + ext[0]) ox[nx++] = ax;
+      if (std::abs(ay) <= ry + ext[1]) oy[ny++] = ay;
+      for (int ix = 0; ix < nx; ++ix) {
+        for (int iy = 0; iy < ny; ++iy) {
+          if (test(ox[ix], oy[iy], rx, ry)) return true;
+        }
+      }
+      return false;
+    }
+
+
+    class convex_cull
+    {
+    public:
+      bool operator()(const aabb_t& bbox) const
+      {
+        return any_image(ref_, ext_, bbox, eps_, [this](float dx, float dy, float rx, float ry) {
+          return hrtree::detail::convex_sat(shape_, dx, dy, rx, ry);
+        });
+      }
+
+    protected:
+      explicit convex_cull(float eps) : eps_(eps) {}
+
+      void init()
+      {
+        ref_ = wrap(vec_t{ shape_.ref[0], shape_.ref[1] });
+        shape_.ref[0] = ref_[0];
+        shape_.ref[1] = ref_[1];
+        ext_ = { std::max(-shape_.x0, shape_.x1), std::max(-shape_.y0, shape_.y1) };
+      }
+
+      hrtree::detail::convex_shape<float> shape_;
+      vec_t ref_;
+      vec_t ext_;
+      float eps_;
+    };
+
+  }
+
+
+  // convex polygon, vertices in either winding.
+  // The vertices need not be wrapped but shall be given
+  // as one piece, e.g. { {0.9, 0.5}, {1.1, 0.4}, {1.1, 0.6} }.
+  class polygon_cull : public detail::convex_cull
+  {
+  public:
+    template <typename FwdIt>
+    polygon_cull(FwdIt first, FwdIt last, float eps = reps) : convex_cull(eps)
+    {
+      shape_.polygon(first, last, [](const vec_t& p, int d) { return p[d]; });
+      init();
+    }
+  };
+
+
+  // oriented box with half extents hu along u, hv across.
+  // u needs not to be normalized.
+  class obb_cull : public detail::convex_cull
+  {
+  public:
+    obb_cull(const vec_t& center, const vec_t& u, float hu, float hv, float eps = reps) : convex_cull(eps)
+    {
+      shape_.obb(center[0], center[1], u[0], u[1], hu, hv);
+      init();
+    }
+  };
+
+
+  // disc of radius r
+  class disc_cull
+  {
+  public:
+    disc_cull(const vec_t& center, float r, float eps = reps) : center_(wrap(center)), r_(r), eps_(eps) {}
+
+    bool operator()(const aabb_t& bbox) const
+    {
+      return detail::any_image(center_, { r_, r_ }, bbox, eps_, [r = r_](float dx, float dy, float rx, float ry) {
+        return hrtree::detail::disc_overlap(dx, dy, rx, ry, r);
+      });
+    }
+
+  private:
+    vec_t center_;
+    float r_;
+    float eps_;
+  };
+
+
+  // ring r0 <= distance <= r1
+  class annulus_cull
+  {
+  public:
+    annulus_cull(const vec_t& center, float r0, float r1, float eps = reps) : center_(wrap(center)), r0_(r0), r1_(r1), eps_(eps) {}
+
+    bool operator()(const aabb_t& bbox) const
+    {
+      return detail::any_image(center_, { r1_, r1_ }, bbox, eps_, [r0 = r0_, r1 = r1_](float dx, float dy, float rx, float ry) {
+        return hrtree::detail::annulus_overlap(dx, dy, rx, ry, r0, r1);
+      });
+    }
+
+  private:
+    vec_t center_;
+    float r0_, r1_;
+    float eps_;
+  };
+
+}
+
+#endif